@@ -0,0 +1,97 @@
+#include "Arena.h"
+
+#include <algorithm>
+
+using namespace dae;
+
+namespace
+{
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+#pragma region Arena
+Arena::Arena(size_t blockSize) :
+	m_BlockSize{ blockSize }
+{
+}
+
+void Arena::Reset()
+{
+	if (m_Blocks.size() > 1) m_Blocks.erase(m_Blocks.begin() + 1, m_Blocks.end());
+
+	m_Offset = 0;
+	m_BytesAllocated = 0;
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment)
+{
+	//Blocks are allocated with new[], aligned for any fundamental type
+	alignment = std::max(alignment, alignof(std::max_align_t));
+
+	if (m_Blocks.empty() || AlignUp(m_Offset, alignment) + bytes > m_Blocks.back().size)
+		AddBlock(bytes + alignment);
+
+	m_Offset = AlignUp(m_Offset, alignment);
+
+	void* pMemory{ m_Blocks.back().pData.get() + m_Offset };
+	m_Offset += bytes;
+	m_BytesAllocated += bytes;
+
+	return pMemory;
+}
+
+void Arena::AddBlock(size_t minimumSize)
+{
+	//Large allocations (e.g. mesh geometry) get a block of their own
+	const size_t size{ std::max(m_BlockSize, minimumSize) };
+
+	m_Blocks.push_back(Block{ std::make_unique<std::byte[]>(size), size });
+	m_Offset = 0;
+}
+#pragma endregion
+
+#pragma region ScratchAllocator
+std::atomic<uint64_t> ScratchAllocator::s_Frame{ 1 };
+
+ScratchAllocator& ScratchAllocator::GetThreadLocal()
+{
+	thread_local ScratchAllocator allocator{};
+	return allocator;
+}
+
+void* ScratchAllocator::Allocate(size_t bytes, size_t alignment)
+{
+	if (m_Frame != s_Frame.load(std::memory_order_relaxed)) BeginThreadFrame();
+
+	const size_t offset{ AlignUp(m_Offset, alignment) };
+	if (offset + bytes <= m_Size)
+	{
+		m_Offset = offset + bytes;
+		return m_pData.get() + offset;
+	}
+
+	//Does not fit, this frame it gets its own block
+	m_OverflowSize += bytes + alignment;
+	m_Overflow.push_back(std::make_unique<std::byte[]>(bytes + alignment));
+
+	return reinterpret_cast<std::byte*>(AlignUp(reinterpret_cast<uintptr_t>(m_Overflow.back().get()), alignment));
+}
+
+void ScratchAllocator::BeginThreadFrame()
+{
+	m_Frame = s_Frame.load(std::memory_order_relaxed);
+	m_Offset = 0;
+
+	if (m_pData && m_Overflow.empty()) return;
+
+	//Grow so last frame's peak fits in one block
+	m_Size = std::max(InitialSize, (m_Size + m_OverflowSize) * 2);
+	m_pData = std::make_unique<std::byte[]>(m_Size);
+
+	m_Overflow.clear();
+	m_OverflowSize = 0;
+}
+#pragma endregion
@@ -0,0 +1,122 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace dae
+{
+	//Scene lifetime bump allocator: allocations are a pointer increment, deallocation is a no-op and
+	//all memory is returned at once when the arena is reset or destroyed.
+	//It is a memory_resource so std::pmr containers (and Buffer) can allocate from it.
+	//Only for storage allocated once at its final size: whatever a container frees by growing or shrinking stays used until the reset.
+	class Arena final : public std::pmr::memory_resource
+	{
+	public:
+		explicit Arena(size_t blockSize = 1 << 20);
+		~Arena() override = default;
+
+		Arena(const Arena&) = delete;
+		Arena(Arena&&) noexcept = delete;
+		Arena& operator=(const Arena&) = delete;
+		Arena& operator=(Arena&&) noexcept = delete;
+
+		//Everything allocated before is invalid afterwards, the first block is kept
+		void Reset();
+
+		size_t GetBytesAllocated() const { return m_BytesAllocated; }
+
+	private:
+		struct Block
+		{
+			std::unique_ptr<std::byte[]> pData;
+			size_t size;
+		};
+
+		std::vector<Block> m_Blocks{};
+		size_t m_BlockSize;
+		size_t m_Offset{}; //In the last block
+		size_t m_BytesAllocated{};
+
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void*, size_t, size_t) override {}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+		void AddBlock(size_t minimumSize);
+	};
+
+	//Per thread linear allocator for temporary memory while rendering a frame
+	//Memory is released by the ScratchScope that was opened before the allocation, and everything is released when a new frame starts.
+	//Blocks are kept between frames, so once warmed up rendering does not touch the heap.
+	class ScratchAllocator final
+	{
+	public:
+		static ScratchAllocator& GetThreadLocal();
+
+		//Called once per frame before rendering, the threads reset their allocator on their next allocation
+		static void BeginFrame() { s_Frame.fetch_add(1, std::memory_order_relaxed); }
+
+		ScratchAllocator(const ScratchAllocator&) = delete;
+		ScratchAllocator(ScratchAllocator&&) noexcept = delete;
+		ScratchAllocator& operator=(const ScratchAllocator&) = delete;
+		ScratchAllocator& operator=(ScratchAllocator&&) noexcept = delete;
+
+		//Uninitialized, only for trivially destructible types
+		template<typename T>
+		T* Allocate(size_t count)
+		{
+			static_assert(std::is_trivially_destructible_v<T>);
+			return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+		}
+
+		void* Allocate(size_t bytes, size_t alignment);
+
+		size_t GetMarker() const { return m_Offset; }
+		void Release(size_t marker) { if (m_Frame == s_Frame.load(std::memory_order_relaxed)) m_Offset = marker; }
+
+	private:
+		ScratchAllocator() = default;
+		~ScratchAllocator() = default;
+
+		static constexpr size_t InitialSize{ 64 * 1024 };
+		static std::atomic<uint64_t> s_Frame;
+
+		std::unique_ptr<std::byte[]> m_pData{};
+		size_t m_Size{};
+		size_t m_Offset{};
+		uint64_t m_Frame{};
+
+		//Allocations that did not fit this frame, merged into one bigger block at the next frame
+		std::vector<std::unique_ptr<std::byte[]>> m_Overflow{};
+		size_t m_OverflowSize{};
+
+		void BeginThreadFrame();
+	};
+
+	//Releases the scratch memory allocated in its lifetime
+	class ScratchScope final
+	{
+	public:
+		ScratchScope() :
+			m_Allocator{ ScratchAllocator::GetThreadLocal() },
+			m_Marker{ m_Allocator.GetMarker() }
+		{
+		}
+
+		~ScratchScope() { m_Allocator.Release(m_Marker); }
+
+		ScratchScope(const ScratchScope&) = delete;
+		ScratchScope(ScratchScope&&) noexcept = delete;
+		ScratchScope& operator=(const ScratchScope&) = delete;
+		ScratchScope& operator=(ScratchScope&&) noexcept = delete;
+
+		template<typename T>
+		T* Allocate(size_t count) { return m_Allocator.Allocate<T>(count); }
+
+	private:
+		ScratchAllocator& m_Allocator;
+		size_t m_Marker;
+	};
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <cassert>
 #include "Math.h"
+#include "LookupTable.h"
 
 namespace dae
 {
@@ -36,6 +37,23 @@ namespace dae
 			return ColorRGB{ 1.f,1.f,1.f }*std::max(0.f, ks * powf(std::max(Vector3::Dot(l - (2.f * std::max(Vector3::Dot(n, l), 0.f) * n), v), 0.f), exp));
 		}
 
+		/**
+		 * \brief Phong using a precomputed power table instead of powf
+		 * \param ks Specular Reflection Coefficient
+		 * \param powerTable Table of x^(Phong Exponent), falls back to powf when invalid
+		 * \param l Incoming (incident) Light Direction
+		 * \param v View Direction
+		 * \param n Normal of the Surface
+		 * \return Phong Specular Color
+		 */
+		static ColorRGB Phong(float ks, const PowerTable& powerTable, const Vector3& l, const Vector3& v, const Vector3& n)
+		{
+			const float cosAlpha{ std::max(Vector3::Dot(l - (2.f * std::max(Vector3::Dot(n, l), 0.f) * n), v), 0.f) };
+			const float specular{ powerTable.IsValid() ? powerTable.Evaluate(cosAlpha) : powf(cosAlpha, powerTable.GetExponent()) };
+
+			return ColorRGB{ 1.f,1.f,1.f } * std::max(0.f, ks * specular);
+		}
+
 		/**
 		 * \brief BRDF Fresnel Function >> Schlick
 		 * \param h Normalized Halfvector between View and Light directions
@@ -51,39 +69,109 @@ namespace dae
 		}
 
 		/**
-		 * \brief BRDF NormalDistribution >> Trowbridge-Reitz GGX (UE4 implemetation - squared(roughness))
+		 * \brief BRDF Fresnel Function >> Schlick, 5th power read from a table when it is valid
+		 * \param h Normalized Halfvector between View and Light directions
+		 * \param v Normalized View direction
+		 * \param f0 Base reflectivity of a surface
+		 * \param fifthPowerTable Table of x^5
+		 * \return
+		 */
+		static ColorRGB FresnelFunction_Schlick(const Vector3& h, const Vector3& v, const ColorRGB& f0, const PowerTable& fifthPowerTable)
+		{
+			if (!fifthPowerTable.IsValid()) return FresnelFunction_Schlick(h, v, f0);
+
+			const float factor{ 1 - std::max(Vector3::Dot(v,h),0.f) };
+
+			return f0 + ((ColorRGB{ 1.f,1.f,1.f } - f0) * fifthPowerTable.Evaluate(factor));
+		}
+
+		/**
+		 * \brief Roughness remapping of the Trowbridge-Reitz GGX normal distribution (UE4 implementation - squared(roughness))
+		 * \param roughness Roughness of the material
+		 * \return alpha², input of NormalDistribution_GGX_Remapped
+		 */
+		static float RemapRoughness_GGX(const float roughness)
+		{
+			return roughness * roughness * roughness * roughness;
+		}
+
+		/**
+		 * \brief Roughness remapping of the Schlick GGX geometry function (Direct Lighting + UE4 implementation - squared(roughness))
+		 * \param roughness Roughness of the material
+		 * \return k, input of GeometryFunction_SchlickGGX_Remapped and GeometryFunction_Smith_Remapped
+		 */
+		static float RemapRoughness_SchlickGGX(const float roughness)
+		{
+			const float factor{ (roughness * roughness) + 1 };
+			return (factor * factor) / 8.f;
+		}
+
+		/**
+		 * \brief BRDF NormalDistribution >> Trowbridge-Reitz GGX, for a roughness remapped once per material
 		 * \param n Surface normal
 		 * \param h Normalized half vector
-		 * \param roughness Roughness of the material
+		 * \param aSquared Remapped roughness, see RemapRoughness_GGX
 		 * \return BRDF Normal Distribution Term using Trowbridge-Reitz GGX
 		 */
-		static float NormalDistribution_GGX(const Vector3& n, const Vector3& h,const float roughness)
+		static float NormalDistribution_GGX_Remapped(const Vector3& n, const Vector3& h, const float aSquared)
 		{
-			const float aSquared{ roughness * roughness * roughness * roughness };
 			const float dotProduct{ std::max(Vector3::Dot(n, h),0.f) };
 			const float factor{ (dotProduct * dotProduct * (aSquared - 1)) + 1 };
 
 			return aSquared / (PI * factor * factor);
 		}
 
+		/**
+		 * \brief BRDF NormalDistribution >> Trowbridge-Reitz GGX
+		 * \param n Surface normal
+		 * \param h Normalized half vector
+		 * \param roughness Roughness of the material
+		 * \return BRDF Normal Distribution Term using Trowbridge-Reitz GGX
+		 */
+		static float NormalDistribution_GGX(const Vector3& n, const Vector3& h, const float roughness)
+		{
+			return NormalDistribution_GGX_Remapped(n, h, RemapRoughness_GGX(roughness));
+		}
 
 		/**
-		 * \brief BRDF Geometry Function >> Schlick GGX (Direct Lighting + UE4 implementation - squared(roughness))
+		 * \brief BRDF Geometry Function >> Schlick GGX, for a roughness remapped once per material
 		 * \param n Normal of the surface
 		 * \param v Normalized view direction
-		 * \param roughness Roughness of the material
+		 * \param k Remapped roughness, see RemapRoughness_SchlickGGX
 		 * \return BRDF Geometry Term using SchlickGGX
 		 */
-		static float GeometryFunction_SchlickGGX(const Vector3& n, const Vector3& v,const float roughness)
+		static float GeometryFunction_SchlickGGX_Remapped(const Vector3& n, const Vector3& v, const float k)
 		{
-			//Direct lightning
-			const float factor{ (roughness * roughness) + 1 };
-			const float k{ (factor * factor) / 8.f };
 			const float dotProduct{ std::max(Vector3::Dot(n, v),0.f) };
 
 			return dotProduct / ((dotProduct * (1 - k)) + k);
 		}
 
+		/**
+		 * \brief BRDF Geometry Function >> Schlick GGX (Direct Lighting + UE4 implementation - squared(roughness))
+		 * \param n Normal of the surface
+		 * \param v Normalized view direction
+		 * \param roughness Roughness of the material
+		 * \return BRDF Geometry Term using SchlickGGX
+		 */
+		static float GeometryFunction_SchlickGGX(const Vector3& n, const Vector3& v, const float roughness)
+		{
+			return GeometryFunction_SchlickGGX_Remapped(n, v, RemapRoughness_SchlickGGX(roughness));
+		}
+
+		/**
+		 * \brief BRDF Geometry Function >> Smith (Direct Lighting), for a roughness remapped once per material
+		 * \param n Normal of the surface
+		 * \param v Normalized view direction
+		 * \param l Normalized light direction
+		 * \param k Remapped roughness, see RemapRoughness_SchlickGGX
+		 * \return BRDF Geometry Term using Smith (> SchlickGGX_Remapped(n,v,k) * SchlickGGX_Remapped(n,l,k))
+		 */
+		static float GeometryFunction_Smith_Remapped(const Vector3& n, const Vector3& v, const Vector3& l, const float k)
+		{
+			return GeometryFunction_SchlickGGX_Remapped(n, v, k) * GeometryFunction_SchlickGGX_Remapped(n, l, k);
+		}
+
 		/**
 		 * \brief BRDF Geometry Function >> Smith (Direct Lighting)
 		 * \param n Normal of the surface
@@ -92,9 +180,9 @@ namespace dae
 		 * \param roughness Roughness of the material
 		 * \return BRDF Geometry Term using Smith (> SchlickGGX(n,v,roughness) * SchlickGGX(n,l,roughness))
 		 */
-		static float GeometryFunction_Smith(const Vector3& n, const Vector3& v, const Vector3& l,const float roughness)
+		static float GeometryFunction_Smith(const Vector3& n, const Vector3& v, const Vector3& l, const float roughness)
 		{
-			return GeometryFunction_SchlickGGX(n, v,roughness) * GeometryFunction_SchlickGGX(n, l, roughness);
+			return GeometryFunction_Smith_Remapped(n, v, l, RemapRoughness_SchlickGGX(roughness));
 		}
 
 	}
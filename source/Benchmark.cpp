@@ -0,0 +1,211 @@
+//External includes
+#include "SDL.h"
+#undef main
+
+//Standard includes
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+//Project includes
+#include "Timer.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "MeshCache.h"
+
+using namespace dae;
+
+//Offline benchmark: renders every scene from a fixed camera path with a fixed timestep,
+//so the numbers only depend on the code and the machine and can be compared between commits.
+namespace
+{
+	struct BenchmarkSettings
+	{
+		int width{ 640 };
+		int height{ 480 };
+		uint32_t warmupFrames{ 3 };
+		uint32_t frames{ 60 };
+		float timeStep{ 1.f / 60.f };
+		float orbitAngle{ 20.f * TO_RADIANS }; //Camera swings this far left and right of the scene camera
+		bool shadowCacheEnabled{ false };
+		std::string outputPath{ "benchmark_results.csv" };
+	};
+
+	struct PassResult
+	{
+		double renderSeconds{};
+		uint64_t primaryRays{};
+		uint64_t shadowRays{};
+	};
+
+	struct SceneResult
+	{
+		std::string name{};
+		double bvhBuildMilliseconds{};
+		float maxLUTError{};
+		double msPerFrame{};
+		double primaryMraysPerSecond{};
+		double shadowMraysPerSecond{}; //Shadow rays per second of the whole render, not of the shadow stage alone
+	};
+
+	struct SceneEntry
+	{
+		const char* name;
+		std::function<Scene*()> create;
+	};
+
+	//Orbits the initial camera around a point in front of it
+	void SetCameraOnPath(Camera& camera, const Vector3& startOrigin, const Vector3& pivot, float angle)
+	{
+		const Matrix rotation{ Matrix::CreateRotationY(angle) };
+
+		camera.SetView(pivot + rotation.TransformVector(startOrigin - pivot), 0.f, angle);
+	}
+
+	PassResult RunPass(const SceneEntry& entry, const BenchmarkSettings& settings, bool shadowsEnabled, SceneResult& sceneResult)
+	{
+		PassResult result{};
+
+		const std::unique_ptr<Scene> pScene{ entry.create() };
+		pScene->Initialize();
+		sceneResult.bvhBuildMilliseconds = pScene->GetBVHBuildTime() * 1000.0;
+		sceneResult.maxLUTError = pScene->GetMaxLUTError();
+
+		Camera& camera{ pScene->GetCamera() };
+		camera.inputEnabled = false;
+
+		const Vector3 startOrigin{ camera.origin };
+		const Vector3 pivot{ startOrigin + Vector3::UnitZ * startOrigin.Magnitude() };
+
+		Renderer renderer{ settings.width, settings.height };
+		renderer.SetShadowsEnabled(shadowsEnabled);
+		renderer.SetShadowCacheEnabled(settings.shadowCacheEnabled);
+
+		Timer timer{};
+
+		const uint32_t totalFrames{ settings.warmupFrames + settings.frames };
+		for (uint32_t frame{}; frame < totalFrames; ++frame)
+		{
+			const float pathPosition{ static_cast<float>(frame) / static_cast<float>(totalFrames) };
+			SetCameraOnPath(camera, startOrigin, pivot, sinf(pathPosition * 2.f * PI) * settings.orbitAngle);
+
+			timer.Step(settings.timeStep);
+			pScene->Update(&timer);
+
+			//Every frame is measured, also when the camera path happens to repeat a view
+			renderer.Invalidate();
+
+			const auto startTime{ std::chrono::steady_clock::now() };
+			renderer.Render(pScene.get());
+			const auto endTime{ std::chrono::steady_clock::now() };
+
+			if (frame < settings.warmupFrames) continue;
+
+			result.renderSeconds += std::chrono::duration<double>(endTime - startTime).count();
+			result.primaryRays += renderer.GetFrameStatistics().primaryRays;
+			result.shadowRays += renderer.GetFrameStatistics().shadowRays;
+		}
+
+		return result;
+	}
+
+	SceneResult RunScene(const SceneEntry& entry, const BenchmarkSettings& settings)
+	{
+		SceneResult result{};
+		result.name = entry.name;
+
+		//Primary rays are measured without shadows, shadow rays over the whole time of the pass with shadows
+		//(the difference between two separately timed passes is mostly noise when shadows add little)
+		const PassResult primaryPass{ RunPass(entry, settings, false, result) };
+		const PassResult fullPass{ RunPass(entry, settings, true, result) };
+
+		result.msPerFrame = fullPass.renderSeconds * 1000.0 / settings.frames;
+		result.primaryMraysPerSecond = primaryPass.primaryRays / primaryPass.renderSeconds * 1e-6;
+		result.shadowMraysPerSecond = fullPass.shadowRays / fullPass.renderSeconds * 1e-6;
+
+		return result;
+	}
+
+	void ParseArguments(int argc, char* args[], BenchmarkSettings& settings)
+	{
+		for (int index{ 1 }; index < argc; ++index)
+		{
+			const bool hasValue{ index + 1 < argc };
+
+			if (strcmp(args[index], "--frames") == 0 && hasValue)
+				settings.frames = static_cast<uint32_t>(std::stoul(args[++index]));
+			else if (strcmp(args[index], "--width") == 0 && hasValue)
+				settings.width = std::stoi(args[++index]);
+			else if (strcmp(args[index], "--height") == 0 && hasValue)
+				settings.height = std::stoi(args[++index]);
+			else if (strcmp(args[index], "--output") == 0 && hasValue)
+				settings.outputPath = args[++index];
+			else if (strcmp(args[index], "--shadowcache") == 0)
+				settings.shadowCacheEnabled = true;
+			else
+				std::cout << "Unknown argument: " << args[index] << std::endl;
+		}
+	}
+}
+
+int main(int argc, char* args[])
+{
+	SDL_Init(SDL_INIT_TIMER);
+
+	BenchmarkSettings settings{};
+	ParseArguments(argc, args, settings);
+
+	//BVH build times are part of the results
+	MeshCache::SetEnabled(false);
+
+	const std::vector<SceneEntry> scenes
+	{
+		{ "W1", [] { return new Scene_W1(); } },
+		{ "W2", [] { return new Scene_W2(); } },
+		{ "W3_TestScene", [] { return new Scene_W3_TestScene(); } },
+		{ "W3_TestScene_LUT", [] { return new Scene_W3_TestScene(0.001f); } }, //Specular powers from lookup tables
+		{ "W3", [] { return new Scene_W3(); } },
+		{ "W4_TestScene", [] { return new Scene_W4_TestScene(); } },
+		{ "W4_ReferenceScene", [] { return new Scene_W4_ReferenceScene(); } },
+		{ "W4_BunnyScene", [] { return new Scene_W4_BunnyScene(); } },
+		{ "W4_CarScene", [] { return new Scene_W4_CarScene(); } }
+	};
+
+	std::cout << "Benchmark " << settings.width << "x" << settings.height << ", " << settings.frames << " frames"
+		<< (settings.shadowCacheEnabled ? ", shadow cache on" : "") << std::endl;
+
+	std::ofstream file{ settings.outputPath };
+	file << std::fixed << std::setprecision(3);
+	file << "scene,width,height,frames,shadow_cache,ms_per_frame,primary_mrays_per_s,shadow_mrays_per_s,bvh_build_ms,max_lut_error\n";
+
+	std::cout << std::fixed << std::setprecision(2);
+	for (const SceneEntry& entry : scenes)
+	{
+		const SceneResult result{ RunScene(entry, settings) };
+
+		std::cout << std::left << std::setw(20) << result.name << std::right
+			<< std::setw(10) << result.msPerFrame << " ms/frame"
+			<< std::setw(10) << result.primaryMraysPerSecond << " primary Mrays/s"
+			<< std::setw(10) << result.shadowMraysPerSecond << " shadow Mrays/s"
+			<< std::setw(10) << result.bvhBuildMilliseconds << " ms BVH build";
+		if (result.maxLUTError > 0.f)
+			std::cout << std::setprecision(5) << std::setw(10) << result.maxLUTError << " max LUT error" << std::setprecision(2);
+		std::cout << std::endl;
+
+		file << result.name << ',' << settings.width << ',' << settings.height << ',' << settings.frames << ','
+			<< (settings.shadowCacheEnabled ? 1 : 0) << ',' << result.msPerFrame << ','
+			<< result.primaryMraysPerSecond << ',' << result.shadowMraysPerSecond << ',' << result.bvhBuildMilliseconds << ','
+			<< std::setprecision(6) << result.maxLUTError << std::setprecision(3) << '\n';
+	}
+
+	std::cout << "Results written to " << settings.outputPath << std::endl;
+
+	SDL_Quit();
+	return 0;
+}
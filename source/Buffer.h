@@ -0,0 +1,174 @@
+#pragma once
+#include <cassert>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace dae
+{
+	//Array that either owns its elements or is a view on memory kept alive by an owner (e.g. a mapped file)
+	//Views are used as they are, anything that changes the size first copies the elements into owned storage.
+	//Copies are always owned, so a copied buffer never aliases the memory of the original.
+	//Owned elements come from a memory resource, by default the heap, but it can be e.g. the scene arena.
+	template<typename T>
+	class Buffer final
+	{
+	public:
+		Buffer() = default;
+		~Buffer() = default;
+
+		explicit Buffer(std::pmr::memory_resource* pResource) : m_Values(pResource) {}
+		Buffer(const std::vector<T>& values) : m_Values(values.begin(), values.end()) { UpdateOwnedView(); }
+
+		Buffer(const Buffer& other) : m_Values(other.begin(), other.end()) { UpdateOwnedView(); }
+		Buffer(Buffer&& other) noexcept :
+			m_Values(std::move(other.m_Values)),
+			m_pOwner(std::move(other.m_pOwner)),
+			m_pData(other.m_pData),
+			m_Size(other.m_Size)
+		{
+			other.m_pData = nullptr;
+			other.m_Size = 0;
+		}
+
+		Buffer& operator=(const Buffer& other)
+		{
+			if (this != &other)
+			{
+				m_Values.assign(other.begin(), other.end());
+				m_pOwner.reset();
+				UpdateOwnedView();
+			}
+			return *this;
+		}
+
+		//With different memory resources the elements are moved one by one, so the data pointer is taken from our own storage
+		Buffer& operator=(Buffer&& other) noexcept
+		{
+			const bool isView{ other.IsView() };
+
+			m_Values = std::move(other.m_Values);
+			m_pOwner = std::move(other.m_pOwner);
+
+			if (isView)
+			{
+				m_pData = other.m_pData;
+				m_Size = other.m_Size;
+			}
+			else UpdateOwnedView();
+
+			other.m_Values.clear();
+			other.m_pData = nullptr;
+			other.m_Size = 0;
+			return *this;
+		}
+
+		//pOwner keeps the memory alive, it may be empty when the memory outlives the buffer
+		void SetView(T* pData, size_t size, std::shared_ptr<const void> pOwner = {})
+		{
+			m_Values.clear();
+			m_Values.shrink_to_fit();
+
+			m_pOwner = std::move(pOwner);
+			m_pData = pData;
+			m_Size = size;
+		}
+
+		bool IsView() const { return m_pData != nullptr && m_pData != m_Values.data(); }
+
+		//Moving a buffer into one on the same resource takes over its elements, otherwise they are moved one by one
+		std::pmr::memory_resource* GetResource() const { return m_Values.get_allocator().resource(); }
+
+		size_t size() const { return m_Size; }
+		bool empty() const { return m_Size == 0; }
+		size_t capacity() const { return IsView() ? m_Size : m_Values.capacity(); }
+
+		T* data() { return m_pData; }
+		const T* data() const { return m_pData; }
+
+		T& operator[](size_t index) { assert(index < m_Size); return m_pData[index]; }
+		const T& operator[](size_t index) const { assert(index < m_Size); return m_pData[index]; }
+
+		T& back() { return m_pData[m_Size - 1]; }
+		const T& back() const { return m_pData[m_Size - 1]; }
+
+		T* begin() { return m_pData; }
+		T* end() { return m_pData + m_Size; }
+		const T* begin() const { return m_pData; }
+		const T* end() const { return m_pData + m_Size; }
+
+		template<typename Iterator>
+		void assign(Iterator first, Iterator last)
+		{
+			m_pOwner.reset();
+			m_Values.assign(first, last);
+			UpdateOwnedView();
+		}
+
+		void clear()
+		{
+			m_pOwner.reset();
+			m_Values.clear();
+			UpdateOwnedView();
+		}
+
+		void reserve(size_t capacity)
+		{
+			MakeOwned();
+			m_Values.reserve(capacity);
+			UpdateOwnedView();
+		}
+
+		void shrink_to_fit()
+		{
+			MakeOwned();
+			m_Values.shrink_to_fit();
+			UpdateOwnedView();
+		}
+
+		void resize(size_t size)
+		{
+			MakeOwned();
+			m_Values.resize(size);
+			UpdateOwnedView();
+		}
+
+		void push_back(const T& value)
+		{
+			MakeOwned();
+			m_Values.push_back(value);
+			UpdateOwnedView();
+		}
+
+		template<typename... Arguments>
+		T& emplace_back(Arguments&&... arguments)
+		{
+			MakeOwned();
+			T& value{ m_Values.emplace_back(std::forward<Arguments>(arguments)...) };
+			UpdateOwnedView();
+			return value;
+		}
+
+	private:
+		std::pmr::vector<T> m_Values{};
+		std::shared_ptr<const void> m_pOwner{};
+
+		T* m_pData{};
+		size_t m_Size{};
+
+		void MakeOwned()
+		{
+			if (!IsView()) return;
+
+			m_Values.assign(m_pData, m_pData + m_Size);
+			m_pOwner.reset();
+			UpdateOwnedView();
+		}
+
+		void UpdateOwnedView()
+		{
+			m_pData = m_Values.data();
+			m_Size = m_Values.size();
+		}
+	};
+}
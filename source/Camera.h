@@ -21,6 +21,7 @@ namespace dae
 		}
 
 		bool hasMoved{ false };
+		bool inputEnabled{ true }; //Disabled for scripted cameras (benchmark)
 
 		Vector3 origin{};
 		float fovAngle{ 90.f };
@@ -54,8 +55,25 @@ namespace dae
 			return cameraToWorld;
 		}
 
+		//Places the camera directly, used for fixed camera paths
+		void SetView(const Vector3& _origin, float pitch, float yaw)
+		{
+			origin = _origin;
+			totalPitch = pitch;
+			totalYaw = yaw;
+			hasMoved = true;
+
+			cameraToWorld = CalculateCameraToWorld();
+		}
+
 		void Update(Timer* pTimer)
 		{
+			if (!inputEnabled)
+			{
+				cameraToWorld = CalculateCameraToWorld();
+				return;
+			}
+
 			const float deltaTime = pTimer->GetElapsed();
 
 			float movementSpeed{ 5.f };
@@ -1,7 +1,12 @@
 #pragma once
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 
 #include "Math.h"
+#include "Buffer.h"
+#include "MeshKernels.h"
+#include "VertexCompression.h"
 #include "vector"
 
 namespace dae
@@ -98,9 +103,17 @@ namespace dae
 			{
 			}
 
-			std::vector<Vector3> positions{};
-			std::vector<Vector3> normals{};
-			std::vector<int> indices{};
+			//The compressed geometry is allocated from pFinalResource, e.g. the arena of the scene. It is built once at its final size
+			//and never changes. Everything that can grow, shrink or be released stays on the heap, an arena would keep every old allocation.
+			explicit TriangleMesh(std::pmr::memory_resource* pFinalResource) :
+				compressedPositions{ pFinalResource }, compressedNormals{ pFinalResource }, compressedVertexNormals{ pFinalResource }
+			{
+			}
+
+			//Owned, or views on a mapped mesh cache (see MeshCache)
+			Buffer<Vector3> positions{};
+			Buffer<Vector3> normals{};
+			Buffer<int> indices{};
 
 			unsigned char materialIndex{};
 
@@ -112,13 +125,50 @@ namespace dae
 			Matrix translationTransform{};
 			Matrix scaleTransform{};
 
-			std::vector<Vector3> transformedPositions{};
-			std::vector<Vector3> transformedNormals{};
-
-			std::vector<BVHNode> bvhNodes{};
+			//Views on positions and normals while the transform is the identity
+			Buffer<Vector3> transformedPositions{};
+			Buffer<Vector3> transformedNormals{};
+
+			//Smooth shading, indexed like positions. Empty for flat shaded meshes (see CalculateVertexNormals)
+			Buffer<Vector3> vertexNormals{};
+			Buffer<Vector3> transformedVertexNormals{};
+
+			//After Compress the geometry only exists in object space in these, the uncompressed buffers above are released
+			//The BVH is then in object space as well and rays are transformed to it, transforming the mesh needs no refit.
+			bool isCompressed{ false };
+			PositionQuantizer positionQuantizer{};
+			Buffer<QuantizedPosition> compressedPositions{};
+			Buffer<uint32_t> compressedNormals{}; //Octahedral, 1 per triangle
+			Buffer<uint32_t> compressedVertexNormals{}; //Octahedral, empty for flat shaded meshes
+			Matrix objectToWorld{};
+			Matrix worldToObject{};
+
+			Buffer<BVHNode> bvhNodes{};
 			uint32_t rootNodeIndex{};
 			uint32_t numberUsedNodes{};
 
+			//Breadth first node order for the parallel refit of big BVHs, built on the first refit after the tree changed (see MeshKernels::RefitLevels)
+			static constexpr uint32_t ParallelRefitMinNodes{ 4096 };
+			std::vector<uint32_t> refitLevelOrder{};
+			std::vector<uint32_t> refitLevelStarts{};
+
+			//Pipelined updates (see Scene::SetPipelined): UpdateTransforms writes the next state into these while the current one
+			//is being rendered, SwapTransforms makes it current. Geometry changes (AppendGeometry, CommitGeometry) are not pipelined.
+			bool isDoubleBuffered{ false };
+			bool hasNextTransforms{ false };
+			Buffer<Vector3> nextTransformedPositions{};
+			Buffer<Vector3> nextTransformedNormals{};
+			Buffer<Vector3> nextTransformedVertexNormals{};
+			Buffer<BVHNode> nextBvhNodes{};
+			Matrix nextObjectToWorld{};
+			Matrix nextWorldToObject{};
+
+			uint32_t transformVersion{}; //Increased every time the transformed geometry changes
+			bool isBVHDirty{ false }; //Triangles were added since the last InitBVH
+			static constexpr uint32_t BVHBuilderVersion{ 2 }; //Increase when InitBVH builds a different tree, invalidates mesh caches
+			static constexpr uint32_t MaxBVHDepth{ 64 }; //Nodes this deep stay leaves, bounds the traversal stack (see GeometryUtils::TraverseBVH)
+			float bvhBuildTime{}; //Seconds spent in the last InitBVH
+
 			void Translate(const Vector3& translation)
 			{
 				translationTransform = Matrix::CreateTranslation(translation);
@@ -134,6 +184,7 @@ namespace dae
 				scaleTransform = Matrix::CreateScale(scale);
 			}
 
+			//Geometry changes are slow one triangle at a time, use AppendGeometry (and AppendTriangle with ignoreTransformUpdate) and CommitGeometry to build bigger meshes
 			void AppendTriangle(const Triangle& triangle, bool ignoreTransformUpdate = false)
 			{
 				int startIndex = static_cast<int>(positions.size());
@@ -147,58 +198,462 @@ namespace dae
 				indices.push_back(++startIndex);
 
 				normals.push_back(triangle.normal);
+				isBVHDirty = true;
 
 				//Not ideal, but making sure all vertices are updated
 				if (!ignoreTransformUpdate)
 					UpdateTransforms();
 			}
 
+			//An empty buffer on the memory resource of the geometry, AppendGeometry takes it over without copying
+			template<typename T>
+			Buffer<T> CreateBuffer() const
+			{
+				return Buffer<T>{ positions.GetResource() };
+			}
+
+			/**
+			 * \brief Appends whole arrays at once, nothing is transformed and the BVH is not touched until CommitGeometry
+			 * An empty mesh takes the buffers over, so views stay views and owned buffers from CreateBuffer are not copied.
+			 * \param newPositions Vertices
+			 * \param newIndices 3 per triangle, relative to newPositions
+			 * \param newNormals 1 per triangle
+			 */
+			void AppendGeometry(Buffer<Vector3>&& newPositions, Buffer<int>&& newIndices, Buffer<Vector3>&& newNormals)
+			{
+				assert(newIndices.size() == newNormals.size() * 3);
+				assert(!isCompressed && "Compressed meshes can not be changed");
+
+				isBVHDirty = true;
+
+				if (indices.empty())
+				{
+					positions = std::move(newPositions);
+					indices = std::move(newIndices);
+					normals = std::move(newNormals);
+					return;
+				}
+
+				const int firstVertex{ static_cast<int>(positions.size()) };
+				const size_t firstIndex{ indices.size() };
+				const size_t firstNormal{ normals.size() };
+
+				positions.resize(positions.size() + newPositions.size());
+				indices.resize(indices.size() + newIndices.size());
+				normals.resize(normals.size() + newNormals.size());
+
+				std::copy(newPositions.begin(), newPositions.end(), positions.begin() + firstVertex);
+				std::copy(newNormals.begin(), newNormals.end(), normals.begin() + firstNormal);
+
+				for (size_t index{}; index < newIndices.size(); ++index)
+				{
+					indices[firstIndex + index] = newIndices[index] + firstVertex;
+				}
+			}
+
+			//Transforms the geometry once, the BVH is rebuilt when triangles were added and refitted otherwise
+			void CommitGeometry()
+			{
+				assert(!isCompressed && "Compressed meshes can not be changed");
+
+				TransformVertices();
+
+				if (isBVHDirty) InitBVH();
+				else RefitBVH();
+
+				++transformVersion;
+			}
+
+			bool HasIdentityTransform() const
+			{
+				const Matrix transformMatrix{ scaleTransform * rotationTransform * translationTransform };
+				const Matrix identity{};
+
+				for (int row{}; row < 4; ++row)
+				{
+					for (int column{}; column < 4; ++column)
+					{
+						if (transformMatrix[row][column] != identity[row][column]) return false;
+					}
+				}
+
+				return true;
+			}
+
 			void UpdateTransforms()
 			{
-				transformedNormals.clear();
-				transformedPositions.clear();
-				transformedNormals.reserve(normals.size());
-				transformedPositions.reserve(positions.size());
+				if (isDoubleBuffered)
+				{
+					UpdateNextTransforms();
+					return;
+				}
+
+				if (isCompressed)
+				{
+					UpdateObjectTransform();
+					++transformVersion;
+					return;
+				}
+
+				TransformVertices();
+				RefitBVH();
+
+				++transformVersion;
+			}
+
+			//Computes the transformed geometry and refitted BVH of the next frame, the current ones are not touched
+			void UpdateNextTransforms()
+			{
+				if (isCompressed)
+				{
+					nextObjectToWorld = scaleTransform * rotationTransform * translationTransform;
+					nextWorldToObject = Matrix::Inverse(nextObjectToWorld);
+					hasNextTransforms = true;
+					return;
+				}
+
+				TransformVertices(nextTransformedPositions, nextTransformedNormals, nextTransformedVertexNormals);
+
+				//Refitting keeps the topology, so after a swap the old nodes only need new bounds. They are copied again after a rebuild (InitBVH clears them)
+				if (nextBvhNodes.size() != bvhNodes.size()) nextBvhNodes.assign(bvhNodes.begin(), bvhNodes.end());
+				RefitBVH(nextBvhNodes, nextTransformedPositions);
+
+				hasNextTransforms = true;
+			}
+
+			//Between frames, makes the state of the last UpdateNextTransforms current
+			void SwapTransforms()
+			{
+				if (!hasNextTransforms) return;
+
+				if (isCompressed)
+				{
+					objectToWorld = nextObjectToWorld;
+					worldToObject = nextWorldToObject;
+				}
+				else
+				{
+					std::swap(transformedPositions, nextTransformedPositions);
+					std::swap(transformedNormals, nextTransformedNormals);
+					std::swap(transformedVertexNormals, nextTransformedVertexNormals);
+					std::swap(bvhNodes, nextBvhNodes);
+				}
+
+				hasNextTransforms = false;
+				++transformVersion;
+			}
+
+			void TransformVertices()
+			{
+				TransformVertices(transformedPositions, transformedNormals, transformedVertexNormals);
+			}
+
+			void TransformVertices(Buffer<Vector3>& targetPositions, Buffer<Vector3>& targetNormals, Buffer<Vector3>& targetVertexNormals)
+			{
+				if (HasIdentityTransform())
+				{
+					//No copies, the original geometry is already in world space
+					targetPositions.SetView(positions.data(), positions.size());
+					targetNormals.SetView(normals.data(), normals.size());
+				}
+				else
+				{
+					if (targetPositions.IsView()) targetPositions.clear();
+					if (targetNormals.IsView()) targetNormals.clear();
+
+					//Only allocates when the vertex count changed, the kernels write into the buffers in place
+					targetPositions.resize(positions.size());
+					targetNormals.resize(normals.size());
+
+					const Matrix transformMatrix{ scaleTransform * rotationTransform * translationTransform };
+
+					MeshKernels::TransformPoints(transformMatrix, positions.data(), targetPositions.data(), positions.size());
+					MeshKernels::TransformNormals(transformMatrix, normals.data(), targetNormals.data(), normals.size());
+				}
+
+				TransformVertexNormals(targetVertexNormals);
+			}
+
+			//Area weighted average of the normals of the triangles sharing a vertex, the mesh is smooth shaded from then on
+			//Vertices are only shared when the indices share them, AppendTriangle gives every triangle its own vertices
+			void CalculateVertexNormals()
+			{
+				assert(!isCompressed && "Calculate the vertex normals before compressing");
+
+				vertexNormals.clear();
+				vertexNormals.resize(positions.size());
+
+				for (size_t index{}; index + 2 < indices.size(); index += 3)
+				{
+					const Vector3& v0{ positions[indices[index]] };
+					const Vector3& v1{ positions[indices[index + 1]] };
+					const Vector3& v2{ positions[indices[index + 2]] };
+
+					//Not normalized, its length is twice the area of the triangle
+					const Vector3 weightedNormal{ Vector3::Cross(v1 - v0, v2 - v0) };
+
+					vertexNormals[indices[index]] += weightedNormal;
+					vertexNormals[indices[index + 1]] += weightedNormal;
+					vertexNormals[indices[index + 2]] += weightedNormal;
+				}
+
+				for (Vector3& normal : vertexNormals)
+				{
+					if (normal.SqrMagnitude() > 0.f) normal.Normalize();
+				}
+
+				TransformVertexNormals();
+			}
+
+			void TransformVertexNormals()
+			{
+				TransformVertexNormals(transformedVertexNormals);
+			}
+
+			void TransformVertexNormals(Buffer<Vector3>& targetVertexNormals)
+			{
+				if (vertexNormals.empty()) return;
+
+				if (HasIdentityTransform())
+				{
+					targetVertexNormals.SetView(vertexNormals.data(), vertexNormals.size());
+					return;
+				}
+
+				if (targetVertexNormals.IsView()) targetVertexNormals.clear();
+				targetVertexNormals.resize(vertexNormals.size());
+
+				const Matrix transformMatrix{ scaleTransform * rotationTransform * translationTransform };
+				MeshKernels::TransformNormals(transformMatrix, vertexNormals.data(), targetVertexNormals.data(), vertexNormals.size());
+			}
+
+			//World space normal at a hit on triangle primitiveIndex, interpolated for smooth shaded meshes
+			Vector3 GetNormal(uint32_t primitiveIndex, float u, float v) const
+			{
+				if (isCompressed)
+				{
+					Vector3 normal{};
+					if (compressedVertexNormals.empty())
+						normal = OctahedralNormal::Decode(compressedNormals[primitiveIndex]);
+					else
+						normal = OctahedralNormal::Decode(compressedVertexNormals[indices[primitiveIndex * 3]]) * (1.f - u - v)
+							+ OctahedralNormal::Decode(compressedVertexNormals[indices[primitiveIndex * 3 + 1]]) * u
+							+ OctahedralNormal::Decode(compressedVertexNormals[indices[primitiveIndex * 3 + 2]]) * v;
+
+					return objectToWorld.TransformVector(normal).Normalized();
+				}
+
+				if (transformedVertexNormals.empty()) return transformedNormals[primitiveIndex];
+
+				const Vector3& n0{ transformedVertexNormals[indices[primitiveIndex * 3]] };
+				const Vector3& n1{ transformedVertexNormals[indices[primitiveIndex * 3 + 1]] };
+				const Vector3& n2{ transformedVertexNormals[indices[primitiveIndex * 3 + 2]] };
+
+				return (n0 * (1.f - u - v) + n1 * u + n2 * v).Normalized();
+			}
+
+			//Bounds of the transformed mesh
+			Aabb GetWorldBounds() const
+			{
+				Aabb bounds{};
+				if (numberUsedNodes == 0) return bounds;
+
+				const BVHNode& root{ bvhNodes[rootNodeIndex] };
+				if (!isCompressed)
+				{
+					bounds.grow(root.minAABB);
+					bounds.grow(root.maxAABB);
+					return bounds;
+				}
+
+				for (int corner{}; corner < 8; ++corner)
+				{
+					bounds.grow(objectToWorld.TransformPoint(
+						corner & 1 ? root.maxAABB.x : root.minAABB.x,
+						corner & 2 ? root.maxAABB.y : root.minAABB.y,
+						corner & 4 ? root.maxAABB.z : root.minAABB.z));
+				}
+				return bounds;
+			}
+
+			/**
+			 * \brief Quantizes the positions to the bounding box of the mesh and encodes the normals, then releases the uncompressed geometry
+			 * Positions take 6 instead of 24 bytes (original and transformed) and normals 4 instead of 24.
+			 * Call it once the geometry is complete (and after CalculateVertexNormals), the BVH is rebuilt in object space.
+			 */
+			void Compress()
+			{
+				if (isCompressed || indices.empty()) return;
+
+				Aabb bounds{};
+				for (const Vector3& position : positions)
+				{
+					bounds.grow(position);
+				}
+				positionQuantizer = PositionQuantizer{ bounds.min, bounds.max };
 
-				auto transformMatrix = scaleTransform * rotationTransform * translationTransform;
+				compressedPositions.clear();
+				compressedPositions.resize(positions.size());
 
+				//The BVH is built on the decoded positions, its boxes contain exactly the triangles the intersection decodes
+				//They are decoded in place, the original positions are not needed anymore
 				for (size_t i = 0; i < positions.size(); i++)
 				{
-					transformedPositions.emplace_back(transformMatrix.TransformPoint(positions[i]));
+					compressedPositions[i] = positionQuantizer.Encode(positions[i]);
+					positions[i] = positionQuantizer.Decode(compressedPositions[i]);
+				}
+
+				//Indexed like the positions, so they are encoded before the build as well
+				compressedVertexNormals.clear();
+				compressedVertexNormals.resize(vertexNormals.size());
+				for (size_t i = 0; i < vertexNormals.size(); i++)
+				{
+					compressedVertexNormals[i] = OctahedralNormal::Encode(vertexNormals[i]);
+				}
+
+				//Everything the build does not read is released first, and so is the old tree, so the new one is not allocated next to them
+				//The views replace the owned transformed geometry
+				transformedPositions.SetView(positions.data(), positions.size());
+				transformedNormals.SetView(normals.data(), normals.size());
+
+				for (Buffer<Vector3>* pBuffer : { &vertexNormals, &transformedVertexNormals, &nextTransformedPositions, &nextTransformedNormals, &nextTransformedVertexNormals })
+				{
+					pBuffer->clear();
+					pBuffer->shrink_to_fit();
 				}
 
+				bvhNodes.clear();
+				bvhNodes.shrink_to_fit();
+				nextBvhNodes.clear();
+				nextBvhNodes.shrink_to_fit();
+
+				InitBVH();
+
+				//The build reserves room for the largest possible tree
+				bvhNodes.resize(numberUsedNodes);
+				bvhNodes.shrink_to_fit();
+
+				//Encoded after the build, it sorts the face normals
+				compressedNormals.clear();
+				compressedNormals.resize(normals.size());
 				for (size_t i = 0; i < normals.size(); i++)
 				{
-					transformedNormals.emplace_back(transformMatrix.TransformVector(normals[i]).Normalized());
+					compressedNormals[i] = OctahedralNormal::Encode(normals[i]);
 				}
 
-				RefitBVH();
+				for (Buffer<Vector3>* pBuffer : { &positions, &normals, &transformedPositions, &transformedNormals })
+				{
+					pBuffer->clear();
+					pBuffer->shrink_to_fit();
+				}
+
+				//Transforming a compressed mesh only changes its matrices, there is nothing to refit
+				refitLevelOrder.shrink_to_fit();
+				refitLevelStarts.shrink_to_fit();
+
+				isCompressed = true;
+				UpdateObjectTransform();
+				++transformVersion;
+			}
+
+			void UpdateObjectTransform()
+			{
+				objectToWorld = scaleTransform * rotationTransform * translationTransform;
+				worldToObject = Matrix::Inverse(objectToWorld);
+			}
+
+			//Object space for compressed meshes, world space otherwise
+			void GetTriangle(uint32_t triangleIndex, Vector3& v0, Vector3& v1, Vector3& v2) const
+			{
+				const int* pIndices{ &indices[triangleIndex * 3] };
+
+				if (isCompressed)
+				{
+					v0 = positionQuantizer.Decode(compressedPositions[pIndices[0]]);
+					v1 = positionQuantizer.Decode(compressedPositions[pIndices[1]]);
+					v2 = positionQuantizer.Decode(compressedPositions[pIndices[2]]);
+					return;
+				}
+
+				v0 = transformedPositions[pIndices[0]];
+				v1 = transformedPositions[pIndices[1]];
+				v2 = transformedPositions[pIndices[2]];
 			}
 
 			void RefitBVH()
 			{
+				RefitBVH(bvhNodes, transformedPositions);
+			}
+
+			//nodes has the topology of bvhNodes, its bounds are fitted to vertices
+			void RefitBVH(Buffer<BVHNode>& nodes, const Buffer<Vector3>& vertices)
+			{
+				if (numberUsedNodes >= ParallelRefitMinNodes)
+				{
+					if (refitLevelStarts.empty()) BuildRefitLevels();
+
+					MeshKernels::RefitLevels(nodes.data(), refitLevelOrder, refitLevelStarts, indices.data(), vertices.data());
+					return;
+				}
+
 				for (int index = numberUsedNodes - 1; index >= 0; index--)
 				{
-					BVHNode& node{ bvhNodes[index] };
+					BVHNode& node{ nodes[index] };
 
 					if (node.nrPrimitives != 0)
 					{
-						UpdateAABB(index);
+						UpdateAABB(node, vertices);
 						continue;
 					}
 
-					BVHNode& leftChild{ bvhNodes[node.leftFirst] };
-					BVHNode& rightChild{bvhNodes[node.leftFirst + 1]};
+					if (node.leftFirst == 0) continue; //Unused (padding) node, children are never at index 0
+
+					BVHNode& leftChild{ nodes[node.leftFirst] };
+					BVHNode& rightChild{ nodes[node.leftFirst + 1] };
 
 					node.minAABB = Vector3::Min(leftChild.minAABB, rightChild.minAABB);
 					node.maxAABB = Vector3::Max(leftChild.maxAABB, rightChild.maxAABB);
 				}
 			}
 
+			//Groups the nodes by depth, every level only depends on the one below it
+			void BuildRefitLevels()
+			{
+				refitLevelOrder.clear();
+				refitLevelStarts.clear();
+				if (numberUsedNodes == 0) return;
+
+				refitLevelOrder.reserve(numberUsedNodes);
+				refitLevelOrder.push_back(rootNodeIndex);
+
+				uint32_t levelStart{};
+				while (levelStart < refitLevelOrder.size())
+				{
+					const uint32_t levelEnd{ static_cast<uint32_t>(refitLevelOrder.size()) };
+					refitLevelStarts.push_back(levelStart);
+
+					for (uint32_t index{ levelStart }; index < levelEnd; ++index)
+					{
+						const BVHNode& node{ bvhNodes[refitLevelOrder[index]] };
+						if (node.nrPrimitives != 0) continue;
+
+						refitLevelOrder.push_back(node.leftFirst);
+						refitLevelOrder.push_back(node.leftFirst + 1);
+					}
+
+					levelStart = levelEnd;
+				}
+
+				refitLevelStarts.push_back(static_cast<uint32_t>(refitLevelOrder.size()));
+			}
+
 			void UpdateAABB(uint32_t nodeIndex)
 			{
-				BVHNode& node{ bvhNodes[nodeIndex] };
+				UpdateAABB(bvhNodes[nodeIndex], transformedPositions);
+			}
 
+			void UpdateAABB(BVHNode& node, const Buffer<Vector3>& vertices) const
+			{
 				uint32_t start{ node.leftFirst * 3 };
 				uint32_t end{ start + node.nrPrimitives * 3 };
 
@@ -207,30 +662,37 @@ namespace dae
 
 				for (uint32_t index{ start }; index < end; ++index)
 				{
-					node.minAABB = Vector3::Min(transformedPositions[indices[index]], node.minAABB);
-					node.maxAABB = Vector3::Max(transformedPositions[indices[index]], node.maxAABB);
+					node.minAABB = Vector3::Min(vertices[indices[index]], node.minAABB);
+					node.maxAABB = Vector3::Max(vertices[indices[index]], node.maxAABB);
 				}
 			}
 
 			void InitBVH()
 			{
+				const auto startTime{ std::chrono::steady_clock::now() };
+
 				nrTriangles = static_cast<int>(indices.size()) / 3;
+				isBVHDirty = false;
 
-				bvhNodes.reserve(nrTriangles * 2 - 1);
+				bvhNodes.clear();
+				nextBvhNodes.clear();
+				refitLevelOrder.clear();
+				refitLevelStarts.clear();
+				rootNodeIndex = 0;
+				numberUsedNodes = 0;
 
-				for (size_t index = 0; index < bvhNodes.capacity(); index++)
-				{
-					bvhNodes.push_back(BVHNode{});
-				}
+				if (nrTriangles == 0) return;
 
-				rootNodeIndex = 0;
+				bvhNodes.resize(nrTriangles * 2 - 1);
 				numberUsedNodes = 1;
 
 				bvhNodes[rootNodeIndex].leftFirst = 0; //No left child
 				bvhNodes[rootNodeIndex].nrPrimitives = nrTriangles; 
 
 				UpdateAABB(rootNodeIndex);
-				Subdivide(rootNodeIndex);
+				Subdivide(rootNodeIndex, 1);
+
+				bvhBuildTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
 			}
 
 			float EvaluateSAH(const BVHNode& node, const int axis, const float position)
@@ -264,8 +726,12 @@ namespace dae
 				return cost > 0 ? cost : INFINITY;
 			}
 
-			void Subdivide(const uint32_t nodeIdx)
+			//depth: of nodeIdx, the root is at depth 1
+			void Subdivide(const uint32_t nodeIdx, const uint32_t depth)
 			{
+				//Degenerate geometry (e.g. many coincident triangles) could otherwise keep splitting off one triangle at a time
+				if (depth >= MaxBVHDepth) return;
+
 				BVHNode& node{ bvhNodes[nodeIdx] };
 
 				int bestAxis{ -1 };
@@ -322,8 +788,8 @@ namespace dae
 				UpdateAABB(leftChildIdx);
 				UpdateAABB(leftChildIdx + 1);
 
-				Subdivide(leftChildIdx);
-				Subdivide(leftChildIdx + 1);
+				Subdivide(leftChildIdx, depth + 1);
+				Subdivide(leftChildIdx + 1, depth + 1);
 			}
 
 			void SortPrimitives(int& left, int right, int axis, float splitPosition)
@@ -338,7 +804,8 @@ namespace dae
 					else
 					{
 						std::swap(normals[left], normals[right]);
-						std::swap(transformedNormals[left], transformedNormals[right]);
+						if (transformedNormals.data() != normals.data())
+							std::swap(transformedNormals[left], transformedNormals[right]);
 
 						for (int i = 0; i < 3; i++)
 						{
@@ -379,13 +846,37 @@ namespace dae
 		float max{ FLT_MAX };
 	};
 
+	enum class HitType : unsigned char
+	{
+		None,
+		Sphere,
+		Plane,
+		Triangle
+	};
+
+	//Traversal only records what was hit, position, normal and material are resolved once for the closest hit (GeometryUtils::ResolveHit)
 	struct HitRecord
 	{
-		Vector3 origin{};
-		Vector3 normal{};
 		float t = FLT_MAX;
-
 		bool didHit{ false };
+		HitType type{ HitType::None };
+
+		//Only for triangles: barycentric weights of v1 and v2, and the triangle within pMesh
+		float u{};
+		float v{};
+		uint32_t primitiveIndex{};
+
+		//Depends on type
+		union
+		{
+			const Sphere* pSphere;
+			const Plane* pPlane;
+			const TriangleMesh* pMesh{ nullptr };
+		};
+
+		//Resolved
+		Vector3 origin{};
+		Vector3 normal{};
 		unsigned char materialIndex{ 0 };
 	};
 #pragma endregion
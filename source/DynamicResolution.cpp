@@ -0,0 +1,38 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace dae;
+
+DynamicResolution::DynamicResolution(float targetFrameTime) :
+	m_TargetFrameTime{ targetFrameTime }
+{
+}
+
+void DynamicResolution::SetEnabled(bool isEnabled)
+{
+	m_IsEnabled = isEnabled;
+	m_Scale = 1.f;
+	m_AverageFrameTime = 0.f;
+}
+
+bool DynamicResolution::Update(float frameTime)
+{
+	if (!m_IsEnabled || frameTime <= 0.f) return false;
+
+	m_AverageFrameTime = m_AverageFrameTime > 0.f ? m_AverageFrameTime + (frameTime - m_AverageFrameTime) * AverageWeight : frameTime;
+
+	const float idealScale{ std::clamp(m_Scale * sqrtf(m_TargetFrameTime / m_AverageFrameTime), MinimumScale, 1.f) };
+
+	float scale{ m_Scale };
+	if (idealScale < m_Scale * 0.95f) scale = std::max(floorf(idealScale / ScaleStep) * ScaleStep, MinimumScale);
+	else if (idealScale >= m_Scale + ScaleStep) scale = std::min(m_Scale + ScaleStep, 1.f);
+
+	if (scale == m_Scale) return false;
+
+	//Frames at the new scale are expected to take this long, so the next change is not based on the old resolution
+	m_AverageFrameTime *= (scale * scale) / (m_Scale * m_Scale);
+	m_Scale = scale;
+	return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+namespace dae
+{
+	//Picks the render resolution scale that keeps the frame time close to a budget, the renderer upscales the image to the window
+	//The cost of a frame is about proportional to its pixels, so the scale follows the square root of the time ratio.
+	//It goes down as soon as frames are too slow, and up one step at a time when there is enough headroom, so it does not oscillate.
+	class DynamicResolution final
+	{
+	public:
+		explicit DynamicResolution(float targetFrameTime = 1.f / 60.f);
+		~DynamicResolution() = default;
+
+		DynamicResolution(const DynamicResolution&) = delete;
+		DynamicResolution(DynamicResolution&&) noexcept = delete;
+		DynamicResolution& operator=(const DynamicResolution&) = delete;
+		DynamicResolution& operator=(DynamicResolution&&) noexcept = delete;
+
+		//Disabling goes back to the full resolution
+		void SetEnabled(bool isEnabled);
+		bool IsEnabled() const { return m_IsEnabled; }
+
+		void SetTargetFrameTime(float seconds) { m_TargetFrameTime = seconds; }
+		float GetTargetFrameTime() const { return m_TargetFrameTime; }
+
+		/**
+		 * \brief Adds the measured time of a rendered frame
+		 * \param frameTime Seconds, e.g. Timer::GetElapsed
+		 * \return true when the scale changed
+		 */
+		bool Update(float frameTime);
+
+		//Fraction of the window width and height that is rendered
+		float GetScale() const { return m_Scale; }
+
+	private:
+		static constexpr float MinimumScale{ 0.25f };
+		static constexpr float ScaleStep{ 1.f / 16.f };
+		static constexpr float AverageWeight{ 0.25f }; //Of the newest frame in the running average
+
+		float m_TargetFrameTime;
+		float m_Scale{ 1.f };
+		float m_AverageFrameTime{};
+		bool m_IsEnabled{ false };
+	};
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace dae
+{
+	//FNV-1a, for change detection and cache keys, not for hash tables
+	//Continue a hash over several blocks by passing the previous result
+	inline uint64_t HashBytes(const void* pData, size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+	{
+		const unsigned char* pBytes{ static_cast<const unsigned char*>(pData) };
+
+		for (size_t index{}; index < size; ++index)
+		{
+			hash ^= pBytes[index];
+			hash *= 0x100000001b3ull;
+		}
+
+		return hash;
+	}
+}
@@ -0,0 +1,237 @@
+#include "LightTree.h"
+
+#include <algorithm>
+#include <cfloat>
+
+using namespace dae;
+
+namespace
+{
+	//xorshift32, returns [0,1)
+	float NextRandom(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		return static_cast<float>(state >> 8) * (1.f / 16777216.f);
+	}
+
+	float MinDistanceSquared(const Vector3& minAABB, const Vector3& maxAABB, const Vector3& position)
+	{
+		const Vector3 closest{ Vector3::Max(minAABB, Vector3::Min(position, maxAABB)) };
+		return (closest - position).SqrMagnitude();
+	}
+}
+
+void LightTree::Build(const std::vector<Light>& lights)
+{
+	m_Nodes.clear();
+	m_LightIndices.clear();
+
+	m_LightPositions.resize(lights.size());
+	m_LightPowers.resize(lights.size());
+
+	for (uint32_t index{}; index < lights.size(); ++index)
+	{
+		const Light& light{ lights[index] };
+
+		m_LightPositions[index] = light.origin;
+		m_LightPowers[index] = light.intensity * std::max(light.color.r, std::max(light.color.g, light.color.b));
+
+		//Directional lights have no position or falloff, the renderer handles them separately
+		if (light.type == LightType::Point)
+			m_LightIndices.push_back(index);
+	}
+
+	if (m_LightIndices.empty()) return;
+
+	m_Nodes.reserve(m_LightIndices.size() * 2 - 1);
+	m_Nodes.push_back(LightNode{ {}, {}, 0.f, 0, static_cast<uint32_t>(m_LightIndices.size()) });
+
+	UpdateNode(0);
+	Subdivide(0);
+}
+
+void LightTree::UpdateNode(uint32_t nodeIndex)
+{
+	LightNode& node{ m_Nodes[nodeIndex] };
+
+	node.minAABB = Vector3{ INFINITY,INFINITY,INFINITY };
+	node.maxAABB = Vector3{ -INFINITY,-INFINITY,-INFINITY };
+	node.power = 0.f;
+
+	for (uint32_t index{ node.leftFirst }; index < node.leftFirst + node.nrLights; ++index)
+	{
+		const uint32_t lightIndex{ m_LightIndices[index] };
+
+		node.minAABB = Vector3::Min(node.minAABB, m_LightPositions[lightIndex]);
+		node.maxAABB = Vector3::Max(node.maxAABB, m_LightPositions[lightIndex]);
+		node.power += m_LightPowers[lightIndex];
+	}
+}
+
+void LightTree::Subdivide(uint32_t nodeIndex)
+{
+	if (m_Nodes[nodeIndex].nrLights <= MaxLightsPerLeaf) return;
+
+	const uint32_t first{ m_Nodes[nodeIndex].leftFirst };
+	const uint32_t count{ m_Nodes[nodeIndex].nrLights };
+
+	//Median split on the longest axis
+	const Vector3 extent{ m_Nodes[nodeIndex].maxAABB - m_Nodes[nodeIndex].minAABB };
+	int axis{ 0 };
+	if (extent.y > extent[axis]) axis = 1;
+	if (extent.z > extent[axis]) axis = 2;
+
+	const uint32_t leftCount{ count / 2 };
+	std::nth_element(m_LightIndices.begin() + first, m_LightIndices.begin() + first + leftCount, m_LightIndices.begin() + first + count,
+		[&](uint32_t a, uint32_t b) { return m_LightPositions[a][axis] < m_LightPositions[b][axis]; });
+
+	const uint32_t leftChildIndex{ static_cast<uint32_t>(m_Nodes.size()) };
+	m_Nodes.push_back(LightNode{ {}, {}, 0.f, first, leftCount });
+	m_Nodes.push_back(LightNode{ {}, {}, 0.f, first + leftCount, count - leftCount });
+
+	m_Nodes[nodeIndex].leftFirst = leftChildIndex;
+	m_Nodes[nodeIndex].nrLights = 0; //Is not leaf
+
+	UpdateNode(leftChildIndex);
+	UpdateNode(leftChildIndex + 1);
+
+	Subdivide(leftChildIndex);
+	Subdivide(leftChildIndex + 1);
+}
+
+uint32_t LightTree::SelectLights(const Vector3& position, float threshold, uint32_t maxSamples, uint32_t& randomState, LightSample* pSamples) const
+{
+	if (m_Nodes.empty()) return 0;
+
+	//Gathering returns at most every point light
+	if (m_LightIndices.size() <= maxSamples) return GatherLights(position, threshold, pSamples);
+
+	uint32_t nrSamples{};
+	for (uint32_t index{}; index < maxSamples; ++index)
+	{
+		LightSample sample{};
+		if (!SampleLight(position, threshold, NextRandom(randomState), sample)) break;
+
+		sample.weight /= static_cast<float>(maxSamples);
+		pSamples[nrSamples++] = sample;
+	}
+
+	return nrSamples;
+}
+
+uint32_t LightTree::GatherLights(const Vector3& position, float threshold, LightSample* pSamples) const
+{
+	uint32_t nrSamples{};
+
+	uint32_t stack[64]{};
+	uint32_t stackSize{};
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const LightNode& node{ m_Nodes[stack[--stackSize]] };
+
+		//Upper bound of the radiance of the whole subtree
+		if (node.power < threshold * MinDistanceSquared(node.minAABB, node.maxAABB, position)) continue;
+
+		if (node.nrLights != 0) //Leaf
+		{
+			for (uint32_t index{ node.leftFirst }; index < node.leftFirst + node.nrLights; ++index)
+			{
+				const uint32_t lightIndex{ m_LightIndices[index] };
+
+				if (m_LightPowers[lightIndex] >= threshold * (m_LightPositions[lightIndex] - position).SqrMagnitude())
+					pSamples[nrSamples++] = LightSample{ lightIndex, 1.f };
+			}
+			continue;
+		}
+
+		stack[stackSize++] = node.leftFirst;
+		stack[stackSize++] = node.leftFirst + 1;
+	}
+
+	return nrSamples;
+}
+
+bool LightTree::SampleLight(const Vector3& position, float threshold, float random, LightSample& sample) const
+{
+	float pdf{ 1.f };
+	const LightNode* pNode{ &m_Nodes[0] };
+
+	//Walk down the tree choosing a child proportional to its importance, reusing the random number
+	while (pNode->nrLights == 0)
+	{
+		const LightNode& left{ m_Nodes[pNode->leftFirst] };
+		const LightNode& right{ m_Nodes[pNode->leftFirst + 1] };
+
+		const float leftImportance{ GetNodeImportance(left, position, threshold) };
+		const float rightImportance{ GetNodeImportance(right, position, threshold) };
+		const float totalImportance{ leftImportance + rightImportance };
+
+		if (totalImportance <= 0.f) return false;
+
+		const float leftProbability{ leftImportance / totalImportance };
+
+		if (random < leftProbability)
+		{
+			random /= leftProbability;
+			pdf *= leftProbability;
+			pNode = &left;
+		}
+		else
+		{
+			random = (random - leftProbability) / (1.f - leftProbability);
+			pdf *= 1.f - leftProbability;
+			pNode = &right;
+		}
+
+		random = std::min(random, 0.99999994f);
+	}
+
+	float totalImportance{};
+	for (uint32_t index{ pNode->leftFirst }; index < pNode->leftFirst + pNode->nrLights; ++index)
+	{
+		totalImportance += GetLightImportance(m_LightIndices[index], position, threshold);
+	}
+
+	if (totalImportance <= 0.f) return false;
+
+	float target{ random * totalImportance };
+	for (uint32_t index{ pNode->leftFirst }; index < pNode->leftFirst + pNode->nrLights; ++index)
+	{
+		const float importance{ GetLightImportance(m_LightIndices[index], position, threshold) };
+
+		if (importance <= 0.f) continue;
+
+		sample.lightIndex = m_LightIndices[index];
+		sample.weight = totalImportance / (importance * pdf);
+
+		if (target < importance) break;
+		target -= importance;
+	}
+
+	return true;
+}
+
+float LightTree::GetNodeImportance(const LightNode& node, const Vector3& position, float threshold) const
+{
+	if (node.power < threshold * MinDistanceSquared(node.minAABB, node.maxAABB, position)) return 0.f;
+
+	//Distance to the center, but never closer than the half diagonal so large nodes are not overestimated
+	const Vector3 center{ (node.minAABB + node.maxAABB) * 0.5f };
+	const float halfDiagonalSquared{ (node.maxAABB - node.minAABB).SqrMagnitude() * 0.25f };
+	const float distanceSquared{ std::max((center - position).SqrMagnitude(), halfDiagonalSquared) };
+
+	return node.power / std::max(distanceSquared, FLT_EPSILON);
+}
+
+float LightTree::GetLightImportance(uint32_t lightIndex, const Vector3& position, float threshold) const
+{
+	const float distanceSquared{ std::max((m_LightPositions[lightIndex] - position).SqrMagnitude(), FLT_EPSILON) };
+	const float importance{ m_LightPowers[lightIndex] / distanceSquared };
+
+	return importance < threshold ? 0.f : importance;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	struct LightSample
+	{
+		uint32_t lightIndex{};
+		float weight{ 1.f }; //1 / (pdf * number of samples)
+	};
+
+	//Binary tree over the point lights of a scene (directional lights are not part of it)
+	//Every node stores the bounds and summed power of its lights, which gives an upper bound on
+	//the radiance a whole subtree can deliver at a point. Subtrees below a threshold are culled,
+	//and with many lights a fixed number of them is picked proportional to estimated contribution.
+	class LightTree final
+	{
+	public:
+		LightTree() = default;
+
+		void Build(const std::vector<Light>& lights);
+
+		/**
+		 * \brief Writes the lights that need a shadow ray at position to pSamples
+		 * \param position Shading point
+		 * \param threshold Lights (or subtrees) with less radiance than this are culled
+		 * \param maxSamples When there are more point lights than this, maxSamples lights are picked stochastically
+		 * \param randomState Per pixel random state
+		 * \param pSamples Output, room for maxSamples samples
+		 * \return Number of samples written
+		 */
+		uint32_t SelectLights(const Vector3& position, float threshold, uint32_t maxSamples, uint32_t& randomState, LightSample* pSamples) const;
+
+		uint32_t GetNumberOfPointLights() const { return static_cast<uint32_t>(m_LightIndices.size()); }
+
+	private:
+		struct LightNode
+		{
+			Vector3 minAABB, maxAABB;
+			float power;
+			uint32_t leftFirst, nrLights;
+		};
+
+		static constexpr uint32_t MaxLightsPerLeaf{ 2 };
+
+		std::vector<LightNode> m_Nodes{};
+		std::vector<uint32_t> m_LightIndices{}; //Point lights, in leaf order
+
+		std::vector<Vector3> m_LightPositions{}; //Indexed by light index
+		std::vector<float> m_LightPowers{}; //Indexed by light index
+
+		void UpdateNode(uint32_t nodeIndex);
+		void Subdivide(uint32_t nodeIndex);
+
+		uint32_t GatherLights(const Vector3& position, float threshold, LightSample* pSamples) const;
+		bool SampleLight(const Vector3& position, float threshold, float random, LightSample& sample) const;
+
+		float GetNodeImportance(const LightNode& node, const Vector3& position, float threshold) const;
+		float GetLightImportance(uint32_t lightIndex, const Vector3& position, float threshold) const;
+	};
+}
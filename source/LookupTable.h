@@ -0,0 +1,87 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+namespace dae
+{
+	//Piecewise linear approximation of x^exponent on [0,1]
+	//The table doubles its resolution until the measured error is below maxError,
+	//if that is not possible within MaxSize entries it stays invalid and callers fall back to powf
+	class PowerTable final
+	{
+	public:
+		PowerTable() = default;
+
+		PowerTable(float exponent, float maxError) :
+			m_Exponent{ exponent }
+		{
+			if (maxError <= 0.f) return;
+
+			for (size_t size{ MinSize }; size <= MaxSize; size *= 2)
+			{
+				Build(size);
+
+				m_Error = MeasureError();
+				if (m_Error <= maxError) return;
+			}
+
+			m_Values.clear();
+			m_Error = 0.f;
+		}
+
+		bool IsValid() const { return !m_Values.empty(); }
+		float GetExponent() const { return m_Exponent; }
+		//Largest difference with powf measured while building, 0 when invalid (callers then use powf)
+		float GetError() const { return m_Error; }
+
+		//x is clamped to [0,1]
+		float Evaluate(float x) const
+		{
+			const float position{ std::clamp(x, 0.f, 1.f) * m_Scale };
+			const size_t index{ static_cast<size_t>(position) };
+
+			if (index >= m_Values.size() - 1) return m_Values.back();
+
+			const float factor{ position - static_cast<float>(index) };
+			return m_Values[index] + (m_Values[index + 1] - m_Values[index]) * factor;
+		}
+
+	private:
+		static constexpr size_t MinSize{ 16 };
+		static constexpr size_t MaxSize{ 1 << 16 };
+
+		std::vector<float> m_Values{};
+		float m_Scale{};
+		float m_Exponent{ 1.f };
+		float m_Error{};
+
+		void Build(size_t size)
+		{
+			m_Values.resize(size + 1);
+			m_Scale = static_cast<float>(size);
+
+			for (size_t index{}; index <= size; ++index)
+			{
+				m_Values[index] = powf(static_cast<float>(index) / m_Scale, m_Exponent);
+			}
+		}
+
+		//Worst error is in between two samples, check the midpoint and both quarter points of every interval
+		float MeasureError() const
+		{
+			float maxError{};
+
+			for (size_t index{}; index < m_Values.size() - 1; ++index)
+			{
+				for (const float offset : { 0.25f, 0.5f, 0.75f })
+				{
+					const float x{ (static_cast<float>(index) + offset) / m_Scale };
+					maxError = std::max(maxError, fabsf(Evaluate(x) - powf(x, m_Exponent)));
+				}
+			}
+
+			return maxError;
+		}
+	};
+}
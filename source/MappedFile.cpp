@@ -0,0 +1,131 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace dae;
+
+MappedFile::MappedFile(const std::string& filename, bool isCopyOnWrite)
+{
+	Open(filename, isCopyOnWrite);
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#if defined(_WIN32)
+bool MappedFile::Open(const std::string& filename, bool isCopyOnWrite)
+{
+	Close();
+
+	const DWORD accessFlags{ isCopyOnWrite ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN };
+	m_FileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | accessFlags, nullptr);
+	if (m_FileHandle == INVALID_HANDLE_VALUE)
+	{
+		m_FileHandle = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(m_FileHandle, &fileSize))
+	{
+		Close();
+		return false;
+	}
+
+	m_Size = static_cast<size_t>(fileSize.QuadPart);
+	if (m_Size == 0)
+	{
+		m_IsEmpty = true;
+		return true;
+	}
+
+	m_MappingHandle = CreateFileMappingA(m_FileHandle, nullptr, isCopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+	if (!m_MappingHandle)
+	{
+		Close();
+		return false;
+	}
+
+	m_pData = static_cast<const char*>(MapViewOfFile(m_MappingHandle, isCopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+	if (!m_pData)
+	{
+		Close();
+		return false;
+	}
+
+	m_IsCopyOnWrite = isCopyOnWrite;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_pData) UnmapViewOfFile(m_pData);
+	if (m_MappingHandle) CloseHandle(m_MappingHandle);
+	if (m_FileHandle) CloseHandle(m_FileHandle);
+
+	m_pData = nullptr;
+	m_MappingHandle = nullptr;
+	m_FileHandle = nullptr;
+	m_Size = 0;
+	m_IsEmpty = false;
+	m_IsCopyOnWrite = false;
+}
+#else
+bool MappedFile::Open(const std::string& filename, bool isCopyOnWrite)
+{
+	Close();
+
+	m_FileDescriptor = open(filename.c_str(), O_RDONLY);
+	if (m_FileDescriptor < 0) return false;
+
+	struct stat fileStatus {};
+	if (fstat(m_FileDescriptor, &fileStatus) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_Size = static_cast<size_t>(fileStatus.st_size);
+	if (m_Size == 0)
+	{
+		m_IsEmpty = true;
+		return true;
+	}
+
+	void* pMapping{ mmap(nullptr, m_Size, isCopyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, m_FileDescriptor, 0) };
+	if (pMapping == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+
+	madvise(pMapping, m_Size, isCopyOnWrite ? MADV_RANDOM : MADV_SEQUENTIAL);
+	m_pData = static_cast<const char*>(pMapping);
+	m_IsCopyOnWrite = isCopyOnWrite;
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_pData) munmap(const_cast<char*>(m_pData), m_Size);
+	if (m_FileDescriptor >= 0) close(m_FileDescriptor);
+
+	m_pData = nullptr;
+	m_FileDescriptor = -1;
+	m_Size = 0;
+	m_IsEmpty = false;
+	m_IsCopyOnWrite = false;
+}
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace dae
+{
+	//Memory mapping of a whole file, the operating system pages it in on demand
+	//Read-only mappings are hinted for reading front to back (parsing). Copy-on-write mappings are meant for
+	//data used in place (geometry): they can be written to, but the changes stay private and never reach the file.
+	class MappedFile final
+	{
+	public:
+		MappedFile() = default;
+		explicit MappedFile(const std::string& filename, bool isCopyOnWrite = false);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) noexcept = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+		bool Open(const std::string& filename, bool isCopyOnWrite = false);
+		void Close();
+
+		bool IsOpen() const { return m_pData != nullptr || m_IsEmpty; }
+		const char* GetData() const { return m_pData; }
+		char* GetWritableData() const { return m_IsCopyOnWrite ? const_cast<char*>(m_pData) : nullptr; }
+		size_t GetSize() const { return m_Size; }
+
+	private:
+		const char* m_pData{};
+		size_t m_Size{};
+		bool m_IsEmpty{ false }; //Empty files can not be mapped but are valid
+		bool m_IsCopyOnWrite{ false };
+
+#if defined(_WIN32)
+		void* m_FileHandle{};
+		void* m_MappingHandle{};
+#else
+		int m_FileDescriptor{ -1 };
+#endif
+	};
+}
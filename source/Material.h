@@ -25,6 +25,9 @@ namespace dae
 		 * \return color
 		 */
 		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
+
+		//Largest measured error of the lookup tables Shade uses, 0 when it only uses exact math
+		virtual float GetLUTError() const { return 0.f; }
 	};
 #pragma endregion
 
@@ -55,16 +58,21 @@ namespace dae
 	{
 	public:
 		Material_Lambert(const ColorRGB& diffuseColor, float diffuseReflectance) :
-			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(diffuseReflectance){}
+			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(diffuseReflectance),
+			m_Diffuse(BRDF::Lambert(diffuseReflectance, diffuseColor))
+		{
+		}
 
 		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
 		{
-			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor);
+			return m_Diffuse;
 		}
 
 	private:
 		ColorRGB m_DiffuseColor{colors::White};
 		float m_DiffuseReflectance{1.f}; //kd
+
+		ColorRGB m_Diffuse{}; //Precomputed Lambert term
 	};
 #pragma endregion
 
@@ -74,22 +82,30 @@ namespace dae
 	class Material_LambertPhong final : public Material
 	{
 	public:
-		Material_LambertPhong(const ColorRGB& diffuseColor, const float kd, const float ks, const float phongExponent):
+		/**
+		 * \param maxLUTError Allowed error of the Phong power table, 0 keeps using powf
+		 */
+		Material_LambertPhong(const ColorRGB& diffuseColor, const float kd, const float ks, const float phongExponent, const float maxLUTError = 0.f):
 			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(kd), m_SpecularReflectance(ks),
-			m_PhongExponent(phongExponent)
+			m_Diffuse(BRDF::Lambert(kd, diffuseColor)),
+			m_PhongTable(phongExponent, maxLUTError)
 		{
 		}
 
 		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
 		{
-			return  { BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor) + BRDF::Phong(m_SpecularReflectance, m_PhongExponent, l, v, hitRecord.normal) };
+			return  { m_Diffuse + BRDF::Phong(m_SpecularReflectance, m_PhongTable, l, v, hitRecord.normal) };
 		}
 
+		float GetLUTError() const override { return m_PhongTable.GetError(); }
+
 	private:
 		ColorRGB m_DiffuseColor{colors::White};
 		float m_DiffuseReflectance{0.5f}; //kd
 		float m_SpecularReflectance{0.5f}; //ks
-		float m_PhongExponent{1.f}; //Phong Exponent
+
+		ColorRGB m_Diffuse{}; //Precomputed Lambert term
+		PowerTable m_PhongTable{};
 	};
 #pragma endregion
 
@@ -98,23 +114,45 @@ namespace dae
 	class Material_CookTorrence final : public Material
 	{
 	public:
-		Material_CookTorrence(const ColorRGB& albedo,const float metalness,const float roughness):
-			m_Albedo(albedo), m_Metalness(metalness), m_Roughness(roughness)
+		/**
+		 * \param maxLUTError Allowed error of the Fresnel 5th power table, 0 keeps the exact power
+		 */
+		Material_CookTorrence(const ColorRGB& albedo,const float metalness,const float roughness, const float maxLUTError = 0.f):
+			m_Albedo(albedo), m_Metalness(metalness), m_Roughness(roughness),
+			m_IsMetal(metalness != 0),
+			m_F0(m_IsMetal ? albedo : ColorRGB{ 1.f,1.f,1.f } * 0.04f),
+			m_DiffuseAlbedo(BRDF::Lambert(1.f, albedo)),
+			m_AlphaSquared(BRDF::RemapRoughness_GGX(roughness)),
+			m_K(BRDF::RemapRoughness_SchlickGGX(roughness)),
+			m_FresnelTable(5.f, maxLUTError)
 		{
 		}
 
 		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
 		{
-			const Vector3 halfVector{ (-v + l) / ((-v + l).Magnitude()) };
-			const ColorRGB fresnel{ BRDF::FresnelFunction_Schlick(halfVector,-v, (m_Metalness == 0) ? (ColorRGB{1.f,1.f,1.f}*0.04f) : m_Albedo) };
+			const Vector3 halfVector{ (l - v).Normalized() };
+			const ColorRGB fresnel{ BRDF::FresnelFunction_Schlick(halfVector, -v, m_F0, m_FresnelTable) };
 
-			return { BRDF::Lambert((m_Metalness == 0 ? ColorRGB{ 1.f,1.f,1.f } - fresnel : ColorRGB{0.f,0.f,0.f}),m_Albedo) + (fresnel * BRDF::NormalDistribution_GGX(hitRecord.normal, halfVector, m_Roughness) * BRDF::GeometryFunction_Smith(hitRecord.normal,-v,l,m_Roughness) * (1 / (4 * Vector3::Dot(-v, hitRecord.normal) * Vector3::Dot(l, hitRecord.normal)))) };
+			const ColorRGB diffuse{ m_IsMetal ? ColorRGB{ 0.f,0.f,0.f } : (ColorRGB{ 1.f,1.f,1.f } - fresnel) * m_DiffuseAlbedo };
+			const float specular{ BRDF::NormalDistribution_GGX_Remapped(hitRecord.normal, halfVector, m_AlphaSquared) * BRDF::GeometryFunction_Smith_Remapped(hitRecord.normal, -v, l, m_K) / (4 * Vector3::Dot(-v, hitRecord.normal) * Vector3::Dot(l, hitRecord.normal)) };
+
+			return { diffuse + fresnel * specular };
 		}
 
+		float GetLUTError() const override { return m_FresnelTable.GetError(); }
+
 	private:
 		ColorRGB m_Albedo{0.955f, 0.637f, 0.538f}; //Copper
 		float m_Metalness{1.0f};
 		float m_Roughness{0.1f}; // [1.0 > 0.0] >> [ROUGH > SMOOTH]
+
+		//Precomputed from metalness and roughness
+		bool m_IsMetal{ true };
+		ColorRGB m_F0{}; //Base reflectivity
+		ColorRGB m_DiffuseAlbedo{}; //Albedo / PI
+		float m_AlphaSquared{}; //roughness^4
+		float m_K{}; //Schlick-GGX direct lighting k
+		PowerTable m_FresnelTable{};
 	};
 #pragma endregion
 }
@@ -82,6 +82,44 @@ namespace dae {
 		return out;
 	}
 
+	const Matrix& Matrix::Inverse()
+	{
+		const Vector3 xAxis{ data[0] };
+		const Vector3 yAxis{ data[1] };
+		const Vector3 zAxis{ data[2] };
+
+		//Columns of the inverse of the 3x3 part
+		const Vector3 xColumn{ Vector3::Cross(yAxis, zAxis) };
+		const Vector3 yColumn{ Vector3::Cross(zAxis, xAxis) };
+		const Vector3 zColumn{ Vector3::Cross(xAxis, yAxis) };
+
+		const float determinant{ Vector3::Dot(xAxis, xColumn) };
+		assert(determinant != 0.f && "Matrix can not be inverted");
+		const float inverseDeterminant{ 1.f / determinant };
+
+		const Vector3 inverseX{ Vector3{ xColumn.x, yColumn.x, zColumn.x } * inverseDeterminant };
+		const Vector3 inverseY{ Vector3{ xColumn.y, yColumn.y, zColumn.y } * inverseDeterminant };
+		const Vector3 inverseZ{ Vector3{ xColumn.z, yColumn.z, zColumn.z } * inverseDeterminant };
+
+		const Vector3 translation{ GetTranslation() };
+		const Vector3 inverseTranslation{ -(inverseX * translation.x + inverseY * translation.y + inverseZ * translation.z) };
+
+		data[0] = { inverseX, 0 };
+		data[1] = { inverseY, 0 };
+		data[2] = { inverseZ, 0 };
+		data[3] = { inverseTranslation, 1 };
+
+		return *this;
+	}
+
+	Matrix Matrix::Inverse(const Matrix& m)
+	{
+		Matrix out{ m };
+		out.Inverse();
+
+		return out;
+	}
+
 	Vector3 Matrix::GetAxisX() const
 	{
 		return data[0];
@@ -0,0 +1,390 @@
+#include "MeshCache.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "Hash.h"
+#include "MappedFile.h"
+#include "Utils.h"
+
+using namespace dae;
+
+namespace
+{
+	std::atomic<bool> g_IsCacheEnabled{ true };
+
+	//The arrays are stored as their in-memory representation
+	static_assert(sizeof(Vector3) == 12 && sizeof(BVHNode) == 32 && sizeof(int) == 4);
+
+	uint64_t AlignOffset(uint64_t offset, uint64_t alignment = MeshCache::SectionAlignment)
+	{
+		return (offset + alignment - 1) & ~(alignment - 1);
+	}
+
+	uint64_t HashMatrix(const Matrix& matrix, uint64_t hash)
+	{
+		for (int row{}; row < 4; ++row)
+		{
+			const Vector4 values{ matrix[row] };
+			const float components[4]{ values.x, values.y, values.z, values.w };
+			hash = HashBytes(components, sizeof(components), hash);
+		}
+
+		return hash;
+	}
+
+	//The size and modification time stand in for the contents, so a launch never reads the OBJ when the cache is valid
+	bool GetSourceHash(const std::string& objFilename, uint64_t& hash)
+	{
+		std::error_code error{};
+		const uint64_t size{ std::filesystem::file_size(objFilename, error) };
+		if (error) return false;
+
+		const auto writeTime{ std::filesystem::last_write_time(objFilename, error).time_since_epoch().count() };
+		if (error) return false;
+
+		hash = HashBytes(&size, sizeof(size));
+		hash = HashBytes(&writeTime, sizeof(writeTime), hash);
+		return true;
+	}
+
+	uint64_t GetSettingsHash(const TriangleMesh& mesh)
+	{
+		uint64_t hash{ HashBytes(&TriangleMesh::BVHBuilderVersion, sizeof(TriangleMesh::BVHBuilderVersion)) };
+
+		//The BVH is built in world space, so the build transform changes the tree
+		hash = HashMatrix(mesh.scaleTransform, hash);
+		hash = HashMatrix(mesh.rotationTransform, hash);
+		hash = HashMatrix(mesh.translationTransform, hash);
+
+		return hash;
+	}
+
+	template<typename T>
+	bool IsValidSection(const MappedFile& file, uint64_t offset, uint32_t count)
+	{
+		return offset % MeshCache::SectionAlignment == 0 && offset <= file.GetSize() && uint64_t{ count } * sizeof(T) <= file.GetSize() - offset;
+	}
+
+	bool ReadHeader(const MappedFile& file, uint64_t sourceHash, uint64_t settingsHash, MeshCache::MeshCacheHeader& header)
+	{
+		if (!file.IsOpen() || file.GetSize() < sizeof(MeshCache::MeshCacheHeader)) return false;
+
+		memcpy(&header, file.GetData(), sizeof(header));
+
+		if (header.magic != MeshCache::Magic || header.formatVersion != MeshCache::FormatVersion) return false;
+		if (header.sourceHash != sourceHash || header.settingsHash != settingsHash) return false;
+		if (header.nrIndices % 3 != 0 || header.nrNormals != header.nrIndices / 3 || header.rootNodeIndex >= header.nrNodes) return false;
+		if (header.nodesOffset % MeshCache::PageSize != 0) return false;
+
+		return IsValidSection<Vector3>(file, header.positionsOffset, header.nrPositions)
+			&& IsValidSection<Vector3>(file, header.normalsOffset, header.nrNormals)
+			&& IsValidSection<int>(file, header.indicesOffset, header.nrIndices)
+			&& IsValidSection<BVHNode>(file, header.nodesOffset, header.nrNodes);
+	}
+
+	//A stale or corrupt cache with a matching header must not make the traversal read outside the arrays
+	bool AreValidIndices(const MappedFile& file, const MeshCache::MeshCacheHeader& header)
+	{
+		const int* pIndices{ reinterpret_cast<const int*>(file.GetData() + header.indicesOffset) };
+
+		for (uint32_t index{}; index < header.nrIndices; ++index)
+		{
+			if (pIndices[index] < 0 || static_cast<uint32_t>(pIndices[index]) >= header.nrPositions) return false;
+		}
+
+		return true;
+	}
+
+	//Walks the nodes the traversal can reach: leaves have to stay inside the triangles and children inside the nodes.
+	//Children are stored after their parent and no deeper than a built tree (see TriangleMesh::MaxBVHDepth), every node
+	//is reached at most once, so neither the walk nor the traversal can loop.
+	bool AreValidNodes(const MappedFile& file, const MeshCache::MeshCacheHeader& header)
+	{
+		const BVHNode* pNodes{ reinterpret_cast<const BVHNode*>(file.GetData() + header.nodesOffset) };
+		const uint32_t nrTriangles{ header.nrIndices / 3 };
+
+		struct PendingNode
+		{
+			uint32_t index;
+			uint32_t depth;
+		};
+
+		std::vector<PendingNode> pendingNodes{ PendingNode{ header.rootNodeIndex, 1 } };
+		uint32_t nrVisitedNodes{};
+
+		while (!pendingNodes.empty())
+		{
+			const PendingNode pending{ pendingNodes.back() };
+			pendingNodes.pop_back();
+
+			if (++nrVisitedNodes > header.nrNodes) return false;
+
+			const BVHNode& node{ pNodes[pending.index] };
+			if (node.nrPrimitives != 0)
+			{
+				if (uint64_t{ node.leftFirst } + node.nrPrimitives > nrTriangles) return false;
+				continue;
+			}
+
+			if (node.leftFirst <= pending.index || uint64_t{ node.leftFirst } + 1 >= header.nrNodes) return false;
+			if (pending.depth >= TriangleMesh::MaxBVHDepth) return false;
+
+			pendingNodes.push_back(PendingNode{ node.leftFirst, pending.depth + 1 });
+			pendingNodes.push_back(PendingNode{ node.leftFirst + 1, pending.depth + 1 });
+		}
+
+		return true;
+	}
+
+	//Sections are validated by ReadHeader
+	template<typename T>
+	void CopySection(const MappedFile& file, uint64_t offset, uint32_t count, Buffer<T>& output)
+	{
+		output.clear();
+		output.resize(count);
+		if (count > 0) memcpy(output.data(), file.GetData() + offset, uint64_t{ count } * sizeof(T));
+	}
+
+	template<typename T>
+	void MapSection(const std::shared_ptr<MappedFile>& pFile, uint64_t offset, uint32_t count, Buffer<T>& output)
+	{
+		output.SetView(reinterpret_cast<T*>(pFile->GetWritableData() + offset), count, pFile);
+	}
+
+	bool LoadCache(const std::string& cacheFilename, uint64_t sourceHash, uint64_t settingsHash, TriangleMesh& mesh)
+	{
+		const MappedFile file{ cacheFilename };
+
+		MeshCache::MeshCacheHeader header{};
+		if (!ReadHeader(file, sourceHash, settingsHash, header)) return false;
+		if (!AreValidIndices(file, header) || !AreValidNodes(file, header)) return false;
+
+		CopySection(file, header.positionsOffset, header.nrPositions, mesh.positions);
+		CopySection(file, header.normalsOffset, header.nrNormals, mesh.normals);
+		CopySection(file, header.indicesOffset, header.nrIndices, mesh.indices);
+		CopySection(file, header.nodesOffset, header.nrNodes, mesh.bvhNodes);
+
+		mesh.nrTriangles = header.nrIndices / 3;
+		mesh.rootNodeIndex = header.rootNodeIndex;
+		mesh.numberUsedNodes = header.nrNodes;
+
+		mesh.UpdateTransforms();
+
+		return true;
+	}
+
+	//Only for meshes with an identity transform, the cached geometry and BVH are used as they are
+	bool MapCache(const std::string& cacheFilename, uint64_t sourceHash, uint64_t settingsHash, TriangleMesh& mesh)
+	{
+		//Copy-on-write, a refit or sort writes to private pages instead of failing on a read-only mapping
+		const auto pFile{ std::make_shared<MappedFile>(cacheFilename, true) };
+
+		MeshCache::MeshCacheHeader header{};
+		if (!ReadHeader(*pFile, sourceHash, settingsHash, header)) return false;
+
+		//Only the nodes, checking the indices would page in all of them
+		if (!AreValidNodes(*pFile, header)) return false;
+
+		MapSection(pFile, header.positionsOffset, header.nrPositions, mesh.positions);
+		MapSection(pFile, header.normalsOffset, header.nrNormals, mesh.normals);
+		MapSection(pFile, header.indicesOffset, header.nrIndices, mesh.indices);
+		MapSection(pFile, header.nodesOffset, header.nrNodes, mesh.bvhNodes);
+
+		mesh.nrTriangles = header.nrIndices / 3;
+		mesh.rootNodeIndex = header.rootNodeIndex;
+		mesh.numberUsedNodes = header.nrNodes;
+
+		//No UpdateTransforms, the refit would touch every page of the BVH for nothing
+		mesh.transformedPositions.SetView(mesh.positions.data(), mesh.positions.size());
+		mesh.transformedNormals.SetView(mesh.normals.data(), mesh.normals.size());
+		++mesh.transformVersion;
+
+		return true;
+	}
+
+	//Reorders the nodes so subtrees share pages. From the root of a group its descendants are placed breadth first
+	//until the page is full, the children that did not fit become the roots of the next groups.
+	//Siblings stay next to each other; index 1 is padding so every pair starts on an even index and never straddles a page.
+	void LayoutNodesForPaging(TriangleMesh& mesh)
+	{
+		if (mesh.numberUsedNodes == 0) return;
+
+		constexpr size_t nodesPerPage{ MeshCache::PageSize / sizeof(BVHNode) };
+
+		const std::vector<BVHNode> oldNodes(mesh.bvhNodes.begin(), mesh.bvhNodes.begin() + mesh.numberUsedNodes);
+
+		std::vector<BVHNode> newNodes{};
+		newNodes.reserve(oldNodes.size() + oldNodes.size() / nodesPerPage + 2);
+		newNodes.push_back(oldNodes[mesh.rootNodeIndex]);
+		newNodes.push_back(BVHNode{}); //Padding
+
+		struct PendingPair
+		{
+			uint32_t oldIndex;
+			uint32_t newParentIndex;
+		};
+
+		std::vector<PendingPair> groupRoots{};
+		std::deque<PendingPair> groupQueue{};
+
+		if (newNodes[0].nrPrimitives == 0) groupRoots.push_back(PendingPair{ newNodes[0].leftFirst, 0 });
+
+		while (!groupRoots.empty())
+		{
+			groupQueue.clear();
+			groupQueue.push_back(groupRoots.back());
+			groupRoots.pop_back();
+
+			while (!groupQueue.empty())
+			{
+				const PendingPair pair{ groupQueue.front() };
+				groupQueue.pop_front();
+
+				const uint32_t newIndex{ static_cast<uint32_t>(newNodes.size()) };
+				newNodes[pair.newParentIndex].leftFirst = newIndex;
+
+				for (uint32_t child{}; child < 2; ++child)
+				{
+					const BVHNode& node{ oldNodes[pair.oldIndex + child] };
+					newNodes.push_back(node);
+
+					if (node.nrPrimitives == 0) groupQueue.push_back(PendingPair{ node.leftFirst, newIndex + child });
+				}
+
+				if (newNodes.size() % nodesPerPage == 0) break;
+			}
+
+			//Reversed so the groups are laid out in the order they were found
+			for (auto it{ groupQueue.rbegin() }; it != groupQueue.rend(); ++it)
+			{
+				groupRoots.push_back(*it);
+			}
+		}
+
+		//Released first, the build reserved room for the largest possible tree
+		mesh.rootNodeIndex = 0;
+		mesh.numberUsedNodes = static_cast<uint32_t>(newNodes.size());
+		mesh.bvhNodes.clear();
+		mesh.bvhNodes.shrink_to_fit();
+		mesh.bvhNodes.assign(newNodes.begin(), newNodes.end());
+		mesh.refitLevelOrder.clear();
+		mesh.refitLevelStarts.clear();
+	}
+
+	template<typename T>
+	void WriteSection(std::ofstream& stream, uint64_t offset, const T* pData, uint32_t count)
+	{
+		static constexpr char padding[MeshCache::PageSize]{};
+
+		const uint64_t position{ static_cast<uint64_t>(stream.tellp()) };
+		stream.write(padding, offset - position);
+		stream.write(reinterpret_cast<const char*>(pData), uint64_t{ count } * sizeof(T));
+	}
+
+	bool SaveCache(const std::string& cacheFilename, uint64_t sourceHash, uint64_t settingsHash, const TriangleMesh& mesh)
+	{
+		MeshCache::MeshCacheHeader header{};
+		header.magic = MeshCache::Magic;
+		header.formatVersion = MeshCache::FormatVersion;
+		header.sourceHash = sourceHash;
+		header.settingsHash = settingsHash;
+
+		header.nrPositions = static_cast<uint32_t>(mesh.positions.size());
+		header.nrNormals = static_cast<uint32_t>(mesh.normals.size());
+		header.nrIndices = static_cast<uint32_t>(mesh.indices.size());
+		header.nrNodes = mesh.numberUsedNodes;
+		header.rootNodeIndex = mesh.rootNodeIndex;
+
+		header.positionsOffset = AlignOffset(sizeof(header));
+		header.normalsOffset = AlignOffset(header.positionsOffset + header.nrPositions * sizeof(Vector3));
+		header.indicesOffset = AlignOffset(header.normalsOffset + header.nrNormals * sizeof(Vector3));
+		header.nodesOffset = AlignOffset(header.indicesOffset + header.nrIndices * sizeof(int), MeshCache::PageSize);
+
+		//Written to a temporary file first so a crash never leaves a truncated cache behind
+		const std::string temporaryFilename{ cacheFilename + ".tmp" };
+		{
+			std::ofstream stream{ temporaryFilename, std::ios::binary | std::ios::trunc };
+			if (!stream) return false;
+
+			stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			WriteSection(stream, header.positionsOffset, mesh.positions.data(), header.nrPositions);
+			WriteSection(stream, header.normalsOffset, mesh.normals.data(), header.nrNormals);
+			WriteSection(stream, header.indicesOffset, mesh.indices.data(), header.nrIndices);
+			WriteSection(stream, header.nodesOffset, mesh.bvhNodes.data(), header.nrNodes);
+
+			if (!stream) return false;
+		}
+
+		std::remove(cacheFilename.c_str());
+		return std::rename(temporaryFilename.c_str(), cacheFilename.c_str()) == 0;
+	}
+}
+
+void MeshCache::SetEnabled(bool isEnabled)
+{
+	g_IsCacheEnabled = isEnabled;
+}
+
+bool MeshCache::LoadOrBuild(const std::string& objFilename, TriangleMesh& mesh, GeometryStorage storage)
+{
+	const std::string cacheFilename{ objFilename + ".meshcache" };
+
+	uint64_t sourceHash{};
+	if (!GetSourceHash(objFilename, sourceHash)) return false;
+
+	const uint64_t settingsHash{ GetSettingsHash(mesh) };
+
+	bool useMapping{ storage == GeometryStorage::Mapped && g_IsCacheEnabled };
+	if (useMapping && !mesh.HasIdentityTransform())
+	{
+		std::cout << objFilename << " is transformed, it is loaded in memory instead of mapped" << std::endl;
+		useMapping = false;
+	}
+
+	if (g_IsCacheEnabled)
+	{
+		const bool isLoaded{ useMapping ? MapCache(cacheFilename, sourceHash, settingsHash, mesh) : LoadCache(cacheFilename, sourceHash, settingsHash, mesh) };
+		if (isLoaded)
+		{
+			mesh.bvhBuildTime = 0.f;
+			return true;
+		}
+	}
+
+	//The parsed arrays are released before the build
+	{
+		std::vector<Vector3> positions{};
+		std::vector<Vector3> normals{};
+		std::vector<int> indices{};
+		if (!Utils::ParseOBJ(objFilename, positions, normals, indices)) return false;
+
+		mesh.positions.assign(positions.begin(), positions.end());
+		mesh.normals.assign(normals.begin(), normals.end());
+		mesh.indices.assign(indices.begin(), indices.end());
+		mesh.bvhNodes.clear();
+	}
+
+	mesh.UpdateTransforms();
+	mesh.InitBVH();
+	LayoutNodesForPaging(mesh);
+
+	if (!g_IsCacheEnabled) return true;
+
+	if (!SaveCache(cacheFilename, sourceHash, settingsHash, mesh))
+	{
+		std::cout << "Could not write mesh cache " << cacheFilename << std::endl;
+		return true;
+	}
+
+	//Swap the freshly built geometry for the mapping, SetView releases the in-memory copy
+	if (useMapping && !MapCache(cacheFilename, sourceHash, settingsHash, mesh))
+		std::cout << "Could not map mesh cache " << cacheFilename << ", it stays in memory" << std::endl;
+
+	return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Binary cache of a parsed OBJ and its built BVH, stored next to the OBJ as <name>.obj.meshcache
+	//Layout: MeshCacheHeader, then the positions, normals, indices and bvhNodes arrays, each 64-byte aligned
+	//so the file can be mapped and used in place. Indices and normals are in BVH leaf order.
+	//The nodes start on a page and are grouped so a subtree shares pages, a traversal touches few pages.
+	//A cache is only used when the format version, the hash of the OBJ's size and modification time and the hash of the
+	//builder settings (builder version and the transform the BVH was built with) all match.
+	//A valid cache is used without reading the OBJ.
+	namespace MeshCache
+	{
+		constexpr uint32_t Magic{ 0x434D5452 }; //"RTMC"
+		constexpr uint32_t FormatVersion{ 3 };
+		constexpr uint64_t SectionAlignment{ 64 };
+		constexpr uint64_t PageSize{ 4096 };
+
+		enum class GeometryStorage
+		{
+			InMemory, //Copied into the mesh
+			Mapped //Used in place from the mapped cache, the OS pages the geometry in and out, for meshes larger than memory
+		};
+
+		struct MeshCacheHeader
+		{
+			uint32_t magic;
+			uint32_t formatVersion;
+			uint64_t sourceHash;
+			uint64_t settingsHash;
+
+			uint32_t nrPositions;
+			uint32_t nrNormals;
+			uint32_t nrIndices;
+			uint32_t nrNodes;
+			uint32_t rootNodeIndex;
+			uint32_t padding;
+
+			uint64_t positionsOffset;
+			uint64_t normalsOffset;
+			uint64_t indicesOffset;
+			uint64_t nodesOffset;
+		};
+
+		//Loads the mesh from the cache, or parses the OBJ, builds the BVH and writes the cache
+		//The mesh transform has to be set before, its transformed geometry is updated.
+		//Mapped storage needs an identity transform (the mapped geometry is used as world space), and
+		//mapped meshes should not be transformed afterwards: that copies the geometry into memory.
+		bool LoadOrBuild(const std::string& objFilename, TriangleMesh& mesh, GeometryStorage storage = GeometryStorage::InMemory);
+
+		//Disabled caches always parse and build, used by the benchmark to measure the build
+		void SetEnabled(bool isEnabled);
+	}
+}
@@ -0,0 +1,176 @@
+#include "MeshKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ppl.h>
+
+#include "DataTypes.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#include <immintrin.h>
+#define MESH_KERNELS_SIMD
+#endif
+
+using namespace dae;
+
+namespace
+{
+	constexpr size_t TransformBlockSize{ 4096 }; //Vertices per parallel task
+	constexpr uint32_t RefitBlockSize{ 512 }; //Nodes per parallel task, narrower levels are refitted on the calling thread
+
+	static_assert(sizeof(Vector3) == 3 * sizeof(float), "The kernels read vertices as packed floats");
+
+	template<typename Kernel>
+	void ForEachBlock(size_t count, size_t blockSize, const Kernel& kernel)
+	{
+		if (count <= blockSize)
+		{
+			kernel(size_t{}, count);
+			return;
+		}
+
+		const size_t nrBlocks{ (count + blockSize - 1) / blockSize };
+		concurrency::parallel_for(size_t{}, nrBlocks, [&](size_t block)
+			{
+				kernel(block * blockSize, std::min((block + 1) * blockSize, count));
+			});
+	}
+
+#if defined(MESH_KERNELS_SIMD)
+	//4 vertices (x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3) to one register per component
+	void LoadVertices(const Vector3* pVertices, __m128& x, __m128& y, __m128& z)
+	{
+		const float* pFloats{ reinterpret_cast<const float*>(pVertices) };
+		const __m128 a{ _mm_loadu_ps(pFloats) };
+		const __m128 b{ _mm_loadu_ps(pFloats + 4) };
+		const __m128 c{ _mm_loadu_ps(pFloats + 8) };
+
+		x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+		y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+		z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+	}
+
+	void StoreVertices(Vector3* pVertices, __m128 x, __m128 y, __m128 z)
+	{
+		float* pFloats{ reinterpret_cast<float*>(pVertices) };
+
+		_mm_storeu_ps(pFloats, _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(pFloats + 4, _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(pFloats + 8, _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+	}
+
+	//Same order of operations as Matrix::TransformVector, so the results match the scalar remainder
+	void TransformBlock(const Matrix& transform, const Vector3* pInput, Vector3* pOutput, size_t& index, size_t end, bool isPoint, bool normalize)
+	{
+		const __m128 m00{ _mm_set1_ps(transform[0].x) }, m01{ _mm_set1_ps(transform[0].y) }, m02{ _mm_set1_ps(transform[0].z) };
+		const __m128 m10{ _mm_set1_ps(transform[1].x) }, m11{ _mm_set1_ps(transform[1].y) }, m12{ _mm_set1_ps(transform[1].z) };
+		const __m128 m20{ _mm_set1_ps(transform[2].x) }, m21{ _mm_set1_ps(transform[2].y) }, m22{ _mm_set1_ps(transform[2].z) };
+		const __m128 m30{ _mm_set1_ps(transform[3].x) }, m31{ _mm_set1_ps(transform[3].y) }, m32{ _mm_set1_ps(transform[3].z) };
+
+		for (; index + 4 <= end; index += 4)
+		{
+			__m128 x, y, z;
+			LoadVertices(pInput + index, x, y, z);
+
+			__m128 outputX{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, x), _mm_mul_ps(m10, y)), _mm_mul_ps(m20, z)) };
+			__m128 outputY{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, x), _mm_mul_ps(m11, y)), _mm_mul_ps(m21, z)) };
+			__m128 outputZ{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, x), _mm_mul_ps(m12, y)), _mm_mul_ps(m22, z)) };
+
+			if (isPoint)
+			{
+				outputX = _mm_add_ps(outputX, m30);
+				outputY = _mm_add_ps(outputY, m31);
+				outputZ = _mm_add_ps(outputZ, m32);
+			}
+
+			if (normalize)
+			{
+				const __m128 magnitude{ _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(outputX, outputX), _mm_mul_ps(outputY, outputY)), _mm_mul_ps(outputZ, outputZ))) };
+				outputX = _mm_div_ps(outputX, magnitude);
+				outputY = _mm_div_ps(outputY, magnitude);
+				outputZ = _mm_div_ps(outputZ, magnitude);
+			}
+
+			StoreVertices(pOutput + index, outputX, outputY, outputZ);
+		}
+	}
+#endif
+
+	void RefitNode(BVHNode* pNodes, uint32_t nodeIndex, const int* pIndices, const Vector3* pVertices)
+	{
+		BVHNode& node{ pNodes[nodeIndex] };
+
+		if (node.nrPrimitives == 0)
+		{
+			if (node.leftFirst == 0) return; //Unused (padding) node, children are never at index 0
+
+			const BVHNode& leftChild{ pNodes[node.leftFirst] };
+			const BVHNode& rightChild{ pNodes[node.leftFirst + 1] };
+
+			node.minAABB = Vector3::Min(leftChild.minAABB, rightChild.minAABB);
+			node.maxAABB = Vector3::Max(leftChild.maxAABB, rightChild.maxAABB);
+			return;
+		}
+
+		const uint32_t start{ node.leftFirst * 3 };
+		const uint32_t end{ start + node.nrPrimitives * 3 };
+
+		node.minAABB = Vector3{ INFINITY,INFINITY,INFINITY };
+		node.maxAABB = Vector3{ -INFINITY,-INFINITY,-INFINITY };
+
+		for (uint32_t index{ start }; index < end; ++index)
+		{
+			node.minAABB = Vector3::Min(pVertices[pIndices[index]], node.minAABB);
+			node.maxAABB = Vector3::Max(pVertices[pIndices[index]], node.maxAABB);
+		}
+	}
+}
+
+void MeshKernels::TransformPoints(const Matrix& transform, const Vector3* pPoints, Vector3* pOutput, size_t count)
+{
+	ForEachBlock(count, TransformBlockSize, [&](size_t first, size_t end)
+		{
+			size_t index{ first };
+#if defined(MESH_KERNELS_SIMD)
+			TransformBlock(transform, pPoints, pOutput, index, end, true, false);
+#endif
+			//Remainder, or everything without SIMD
+			for (; index < end; ++index)
+			{
+				pOutput[index] = transform.TransformPoint(pPoints[index]);
+			}
+		});
+}
+
+void MeshKernels::TransformNormals(const Matrix& transform, const Vector3* pNormals, Vector3* pOutput, size_t count)
+{
+	ForEachBlock(count, TransformBlockSize, [&](size_t first, size_t end)
+		{
+			size_t index{ first };
+#if defined(MESH_KERNELS_SIMD)
+			TransformBlock(transform, pNormals, pOutput, index, end, false, true);
+#endif
+			//Remainder, or everything without SIMD
+			for (; index < end; ++index)
+			{
+				pOutput[index] = transform.TransformVector(pNormals[index]).Normalized();
+			}
+		});
+}
+
+void MeshKernels::RefitLevels(BVHNode* pNodes, const std::vector<uint32_t>& levelOrder, const std::vector<uint32_t>& levelStarts, const int* pIndices, const Vector3* pVertices)
+{
+	for (size_t level{ levelStarts.size() - 1 }; level-- > 0;)
+	{
+		const uint32_t levelStart{ levelStarts[level] };
+		const uint32_t nrLevelNodes{ levelStarts[level + 1] - levelStart };
+
+		ForEachBlock(nrLevelNodes, RefitBlockSize, [&](size_t first, size_t end)
+			{
+				for (size_t index{ first }; index < end; ++index)
+				{
+					RefitNode(pNodes, levelOrder[levelStart + index], pIndices, pVertices);
+				}
+			});
+	}
+}
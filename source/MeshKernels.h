@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	struct BVHNode;
+
+	//Per frame work on big meshes, split into blocks that run in parallel (see TriangleMesh::TransformVertices and RefitBVH)
+	namespace MeshKernels
+	{
+		//pOutput has room for count elements, it may not overlap pPoints
+		void TransformPoints(const Matrix& transform, const Vector3* pPoints, Vector3* pOutput, size_t count);
+		//Normalized after the transform, like Matrix::TransformVector(...).Normalized()
+		void TransformNormals(const Matrix& transform, const Vector3* pNormals, Vector3* pOutput, size_t count);
+
+		/**
+		 * \brief Refits the nodes bottom-up, one level at a time. The nodes of a level only read the level below, so wide levels run in parallel
+		 * \param levelOrder Node indices, breadth first from the root
+		 * \param levelStarts Index in levelOrder of the first node of every level, plus levelOrder.size()
+		 * \param pIndices 3 per triangle, the leaves range over them as in TriangleMesh
+		 */
+		void RefitLevels(BVHNode* pNodes, const std::vector<uint32_t>& levelOrder, const std::vector<uint32_t>& levelStarts, const int* pIndices, const Vector3* pVertices);
+	}
+}
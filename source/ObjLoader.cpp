@@ -0,0 +1,455 @@
+#include "ObjLoader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <ppl.h>
+
+#include "MappedFile.h"
+
+using namespace dae;
+
+namespace
+{
+	constexpr size_t MinChunkSize{ 1 << 20 };
+	constexpr int32_t MissingIndex{ INT32_MIN };
+
+	enum RelativeFlags : uint8_t
+	{
+		RelativePosition = 1,
+		RelativeTexCoord = 2,
+		RelativeNormal = 4
+	};
+
+	//Face corner with 1-based indices as written in the file, or 0-based relative to the start of the chunk
+	//for negative indices, those are resolved once the chunk offsets are known
+	struct FaceCorner
+	{
+		int32_t position{ MissingIndex };
+		int32_t texCoord{ MissingIndex };
+		int32_t normal{ MissingIndex };
+		uint8_t relativeFlags{};
+	};
+
+	enum class GroupMarkerType
+	{
+		Object,
+		Group,
+		Material
+	};
+
+	struct GroupMarker
+	{
+		GroupMarkerType type;
+		uint32_t triangle; //First triangle of the chunk after the marker
+		std::string name;
+	};
+
+	//Result of one chunk, indices still relative to the chunk
+	struct ObjChunk
+	{
+		std::vector<Vector3> positions{};
+		std::vector<ObjTexCoord> texCoords{};
+		std::vector<Vector3> normals{};
+		std::vector<FaceCorner> corners{}; //3 per triangle
+		std::vector<GroupMarker> markers{};
+	};
+
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	void SkipSpaces(const char*& pCurrent, const char* pEnd)
+	{
+		while (pCurrent < pEnd && IsSpace(*pCurrent)) ++pCurrent;
+	}
+
+	void SkipLine(const char*& pCurrent, const char* pEnd)
+	{
+		while (pCurrent < pEnd && *pCurrent != '\n') ++pCurrent;
+		if (pCurrent < pEnd) ++pCurrent;
+	}
+
+	bool ParseInt(const char*& pCurrent, const char* pEnd, int32_t& value)
+	{
+		bool isNegative{ false };
+		if (pCurrent < pEnd && (*pCurrent == '-' || *pCurrent == '+'))
+		{
+			isNegative = *pCurrent == '-';
+			++pCurrent;
+		}
+
+		const char* pStart{ pCurrent };
+		int64_t result{};
+		while (pCurrent < pEnd && *pCurrent >= '0' && *pCurrent <= '9')
+		{
+			result = result * 10 + (*pCurrent - '0');
+			++pCurrent;
+		}
+
+		if (pCurrent == pStart || result > INT32_MAX) return false;
+
+		value = static_cast<int32_t>(isNegative ? -result : result);
+		return true;
+	}
+
+	//Decimal and scientific notation, no locale and no allocations
+	bool ParseFloat(const char*& pCurrent, const char* pEnd, float& value)
+	{
+		static constexpr double powersOf10[]
+		{
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+			1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+
+		bool isNegative{ false };
+		if (pCurrent < pEnd && (*pCurrent == '-' || *pCurrent == '+'))
+		{
+			isNegative = *pCurrent == '-';
+			++pCurrent;
+		}
+
+		uint64_t mantissa{};
+		int digits{};
+		int exponent{};
+		bool hasDigits{ false };
+
+		while (pCurrent < pEnd && *pCurrent >= '0' && *pCurrent <= '9')
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*pCurrent - '0');
+				if (mantissa != 0) ++digits;
+			}
+			else ++exponent; //Digits beyond the precision only scale
+
+			hasDigits = true;
+			++pCurrent;
+		}
+
+		if (pCurrent < pEnd && *pCurrent == '.')
+		{
+			++pCurrent;
+			while (pCurrent < pEnd && *pCurrent >= '0' && *pCurrent <= '9')
+			{
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + (*pCurrent - '0');
+					if (mantissa != 0) ++digits;
+					--exponent;
+				}
+
+				hasDigits = true;
+				++pCurrent;
+			}
+		}
+
+		if (!hasDigits) return false;
+
+		if (pCurrent < pEnd && (*pCurrent == 'e' || *pCurrent == 'E'))
+		{
+			const char* pExponent{ pCurrent + 1 };
+			int32_t writtenExponent{};
+			if (ParseInt(pExponent, pEnd, writtenExponent))
+			{
+				exponent += std::clamp(writtenExponent, -400, 400);
+				pCurrent = pExponent;
+			}
+		}
+
+		double result{ static_cast<double>(mantissa) };
+		while (exponent > 22)
+		{
+			result *= 1e22;
+			exponent -= 22;
+		}
+		while (exponent < -22)
+		{
+			result /= 1e22;
+			exponent += 22;
+		}
+		result = exponent >= 0 ? result * powersOf10[exponent] : result / powersOf10[-exponent];
+
+		value = static_cast<float>(isNegative ? -result : result);
+		return true;
+	}
+
+	//v/vt/vn, v//vn, v/vt or v
+	bool ParseCorner(const char*& pCurrent, const char* pEnd, FaceCorner& corner)
+	{
+		corner = FaceCorner{};
+		if (!ParseInt(pCurrent, pEnd, corner.position)) return false;
+
+		if (pCurrent < pEnd && *pCurrent == '/')
+		{
+			++pCurrent;
+			if (pCurrent < pEnd && *pCurrent != '/')
+			{
+				if (!ParseInt(pCurrent, pEnd, corner.texCoord)) return false;
+			}
+
+			if (pCurrent < pEnd && *pCurrent == '/')
+			{
+				++pCurrent;
+				if (!ParseInt(pCurrent, pEnd, corner.normal)) return false;
+			}
+		}
+
+		return true;
+	}
+
+	std::string ParseName(const char*& pCurrent, const char* pEnd)
+	{
+		SkipSpaces(pCurrent, pEnd);
+
+		const char* pStart{ pCurrent };
+		while (pCurrent < pEnd && *pCurrent != '\n') ++pCurrent;
+
+		const char* pNameEnd{ pCurrent };
+		while (pNameEnd > pStart && IsSpace(pNameEnd[-1])) --pNameEnd;
+
+		return { pStart, pNameEnd };
+	}
+
+	//Negative indices count back from the last element read so far
+	void MakeRelative(int32_t& index, size_t count, uint8_t flag, uint8_t& relativeFlags)
+	{
+		if (index >= 0 || index == MissingIndex) return;
+
+		index += static_cast<int32_t>(count);
+		relativeFlags |= flag;
+	}
+
+	void ParseChunk(const char* pCurrent, const char* pEnd, ObjChunk& chunk)
+	{
+		//Rough guess, vertex lines are a few dozen bytes and about half of the file
+		chunk.positions.reserve((pEnd - pCurrent) / 64);
+
+		FaceCorner faceCorners[3]{};
+
+		while (pCurrent < pEnd)
+		{
+			SkipSpaces(pCurrent, pEnd);
+			if (pCurrent >= pEnd) break;
+
+			const char command{ *pCurrent };
+			const char nextCharacter{ pCurrent + 1 < pEnd ? pCurrent[1] : '\n' };
+
+			if (command == 'v' && IsSpace(nextCharacter))
+			{
+				pCurrent += 2;
+				Vector3 position{};
+				for (int axis{}; axis < 3; ++axis)
+				{
+					SkipSpaces(pCurrent, pEnd);
+					ParseFloat(pCurrent, pEnd, position[axis]);
+				}
+				chunk.positions.push_back(position);
+			}
+			else if (command == 'v' && nextCharacter == 'n')
+			{
+				pCurrent += 2;
+				Vector3 normal{};
+				for (int axis{}; axis < 3; ++axis)
+				{
+					SkipSpaces(pCurrent, pEnd);
+					ParseFloat(pCurrent, pEnd, normal[axis]);
+				}
+				chunk.normals.push_back(normal);
+			}
+			else if (command == 'v' && nextCharacter == 't')
+			{
+				pCurrent += 2;
+				ObjTexCoord texCoord{};
+				SkipSpaces(pCurrent, pEnd);
+				ParseFloat(pCurrent, pEnd, texCoord.u);
+				SkipSpaces(pCurrent, pEnd);
+				ParseFloat(pCurrent, pEnd, texCoord.v);
+				chunk.texCoords.push_back(texCoord);
+			}
+			else if (command == 'f' && IsSpace(nextCharacter))
+			{
+				++pCurrent;
+
+				//Polygons are triangulated as a fan around the first corner
+				uint32_t nrCorners{};
+				FaceCorner corner{};
+				while (true)
+				{
+					SkipSpaces(pCurrent, pEnd);
+					if (pCurrent >= pEnd || *pCurrent == '\n' || *pCurrent == '#') break;
+					if (!ParseCorner(pCurrent, pEnd, corner)) break;
+
+					MakeRelative(corner.position, chunk.positions.size(), RelativePosition, corner.relativeFlags);
+					MakeRelative(corner.texCoord, chunk.texCoords.size(), RelativeTexCoord, corner.relativeFlags);
+					MakeRelative(corner.normal, chunk.normals.size(), RelativeNormal, corner.relativeFlags);
+
+					if (nrCorners < 3)
+					{
+						faceCorners[nrCorners] = corner;
+					}
+					else
+					{
+						faceCorners[1] = faceCorners[2];
+						faceCorners[2] = corner;
+					}
+					++nrCorners;
+
+					if (nrCorners >= 3)
+					{
+						chunk.corners.push_back(faceCorners[0]);
+						chunk.corners.push_back(faceCorners[1]);
+						chunk.corners.push_back(faceCorners[2]);
+					}
+				}
+			}
+			else if ((command == 'o' || command == 'g') && IsSpace(nextCharacter))
+			{
+				++pCurrent;
+				const GroupMarkerType type{ command == 'o' ? GroupMarkerType::Object : GroupMarkerType::Group };
+				chunk.markers.push_back(GroupMarker{ type, static_cast<uint32_t>(chunk.corners.size() / 3), ParseName(pCurrent, pEnd) });
+			}
+			else if (command == 'u' && pEnd - pCurrent > 7 && std::equal(pCurrent, pCurrent + 6, "usemtl") && IsSpace(pCurrent[6]))
+			{
+				pCurrent += 6;
+				chunk.markers.push_back(GroupMarker{ GroupMarkerType::Material, static_cast<uint32_t>(chunk.corners.size() / 3), ParseName(pCurrent, pEnd) });
+			}
+
+			SkipLine(pCurrent, pEnd);
+		}
+	}
+
+	uint32_t ResolveIndex(int32_t index, bool isRelative, uint32_t chunkOffset, uint32_t totalCount, bool& isValid)
+	{
+		if (index == MissingIndex) return ObjData::InvalidIndex;
+
+		const int64_t resolvedIndex{ isRelative ? int64_t{ chunkOffset } + index : int64_t{ index } - 1 };
+
+		if (resolvedIndex < 0 || resolvedIndex >= totalCount)
+		{
+			isValid = false;
+			return 0;
+		}
+
+		return static_cast<uint32_t>(resolvedIndex);
+	}
+}
+
+bool ObjLoader::Load(const std::string& filename, ObjData& data)
+{
+	data = ObjData{};
+
+	const MappedFile file{ filename };
+	if (!file.IsOpen()) return false;
+	if (file.GetSize() == 0) return true;
+
+	const char* pData{ file.GetData() };
+	const size_t size{ file.GetSize() };
+
+	//Split on line ends so every chunk can be parsed on its own
+	const size_t maxChunks{ std::max(std::thread::hardware_concurrency(), 1u) * 4 };
+	const size_t chunkSize{ std::max(MinChunkSize, size / maxChunks + 1) };
+
+	std::vector<const char*> chunkStarts{ pData };
+	while (chunkStarts.back() + chunkSize < pData + size)
+	{
+		const char* pSplit{ std::find(chunkStarts.back() + chunkSize, pData + size, '\n') };
+		if (pSplit == pData + size) break;
+
+		chunkStarts.push_back(pSplit + 1);
+	}
+	chunkStarts.push_back(pData + size);
+
+	const uint32_t nrChunks{ static_cast<uint32_t>(chunkStarts.size() - 1) };
+	std::vector<ObjChunk> chunks(nrChunks);
+
+	concurrency::parallel_for(0u, nrChunks, [&](uint32_t chunkIndex)
+		{
+			ParseChunk(chunkStarts[chunkIndex], chunkStarts[chunkIndex + 1], chunks[chunkIndex]);
+		});
+
+	//Offsets of every chunk in the merged arrays
+	std::vector<uint32_t> positionOffsets(nrChunks), texCoordOffsets(nrChunks), normalOffsets(nrChunks), cornerOffsets(nrChunks);
+	uint32_t nrPositions{}, nrTexCoords{}, nrNormals{}, nrCorners{};
+
+	for (uint32_t chunkIndex{}; chunkIndex < nrChunks; ++chunkIndex)
+	{
+		positionOffsets[chunkIndex] = nrPositions;
+		texCoordOffsets[chunkIndex] = nrTexCoords;
+		normalOffsets[chunkIndex] = nrNormals;
+		cornerOffsets[chunkIndex] = nrCorners;
+
+		nrPositions += static_cast<uint32_t>(chunks[chunkIndex].positions.size());
+		nrTexCoords += static_cast<uint32_t>(chunks[chunkIndex].texCoords.size());
+		nrNormals += static_cast<uint32_t>(chunks[chunkIndex].normals.size());
+		nrCorners += static_cast<uint32_t>(chunks[chunkIndex].corners.size());
+	}
+
+	data.positions.resize(nrPositions);
+	data.texCoords.resize(nrTexCoords);
+	data.normals.resize(nrNormals);
+	data.positionIndices.resize(nrCorners);
+	data.texCoordIndices.resize(nrCorners);
+	data.normalIndices.resize(nrCorners);
+
+	std::atomic<bool> isValid{ true };
+
+	concurrency::parallel_for(0u, nrChunks, [&](uint32_t chunkIndex)
+		{
+			const ObjChunk& chunk{ chunks[chunkIndex] };
+
+			std::copy(chunk.positions.begin(), chunk.positions.end(), data.positions.begin() + positionOffsets[chunkIndex]);
+			std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), data.texCoords.begin() + texCoordOffsets[chunkIndex]);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), data.normals.begin() + normalOffsets[chunkIndex]);
+
+			bool isChunkValid{ true };
+			for (size_t cornerIndex{}; cornerIndex < chunk.corners.size(); ++cornerIndex)
+			{
+				const FaceCorner& corner{ chunk.corners[cornerIndex] };
+				const size_t outputIndex{ cornerOffsets[chunkIndex] + cornerIndex };
+
+				data.positionIndices[outputIndex] = ResolveIndex(corner.position, corner.relativeFlags & RelativePosition, positionOffsets[chunkIndex], nrPositions, isChunkValid);
+				data.texCoordIndices[outputIndex] = ResolveIndex(corner.texCoord, corner.relativeFlags & RelativeTexCoord, texCoordOffsets[chunkIndex], nrTexCoords, isChunkValid);
+				data.normalIndices[outputIndex] = ResolveIndex(corner.normal, corner.relativeFlags & RelativeNormal, normalOffsets[chunkIndex], nrNormals, isChunkValid);
+			}
+
+			if (!isChunkValid) isValid = false;
+		});
+
+	if (!isValid) return false;
+
+	//Groups, the o/g/usemtl state carries over chunk boundaries
+	ObjGroup currentGroup{};
+	for (uint32_t chunkIndex{}; chunkIndex < nrChunks; ++chunkIndex)
+	{
+		for (const GroupMarker& marker : chunks[chunkIndex].markers)
+		{
+			const uint32_t triangle{ cornerOffsets[chunkIndex] / 3 + marker.triangle };
+
+			currentGroup.nrTriangles = triangle - currentGroup.firstTriangle;
+			if (currentGroup.nrTriangles > 0) data.groups.push_back(currentGroup);
+
+			currentGroup.firstTriangle = triangle;
+
+			switch (marker.type)
+			{
+			case GroupMarkerType::Object:
+				currentGroup.objectName = marker.name;
+				currentGroup.groupName.clear();
+				break;
+			case GroupMarkerType::Group:
+				currentGroup.groupName = marker.name;
+				break;
+			case GroupMarkerType::Material:
+				currentGroup.materialName = marker.name;
+				break;
+			}
+		}
+	}
+
+	currentGroup.nrTriangles = data.GetNumberOfTriangles() - currentGroup.firstTriangle;
+	if (currentGroup.nrTriangles > 0) data.groups.push_back(currentGroup);
+
+	return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	struct ObjTexCoord
+	{
+		float u{};
+		float v{};
+	};
+
+	//Range of triangles sharing the same o/g/usemtl state
+	struct ObjGroup
+	{
+		std::string objectName{};
+		std::string groupName{};
+		std::string materialName{};
+		uint32_t firstTriangle{};
+		uint32_t nrTriangles{};
+	};
+
+	//Everything is triangulated, every triangle has 3 entries in each index array
+	struct ObjData
+	{
+		static constexpr uint32_t InvalidIndex{ UINT32_MAX }; //Corner without a texture coordinate or normal
+
+		std::vector<Vector3> positions{};
+		std::vector<ObjTexCoord> texCoords{};
+		std::vector<Vector3> normals{};
+
+		std::vector<uint32_t> positionIndices{};
+		std::vector<uint32_t> texCoordIndices{};
+		std::vector<uint32_t> normalIndices{};
+
+		std::vector<ObjGroup> groups{};
+
+		uint32_t GetNumberOfTriangles() const { return static_cast<uint32_t>(positionIndices.size() / 3); }
+	};
+
+	namespace ObjLoader
+	{
+		/**
+		 * \brief Loads a Wavefront OBJ, the file is memory mapped and parsed in parallel chunks
+		 * \param filename Path to the .obj file
+		 * \param data Output, cleared first
+		 * \return false when the file can not be opened or a face references a missing vertex
+		 */
+		bool Load(const std::string& filename, ObjData& data);
+	}
+}
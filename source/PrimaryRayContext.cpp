@@ -0,0 +1,128 @@
+#include "PrimaryRayContext.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace dae;
+
+namespace
+{
+	constexpr float MinimumDepth{ 0.0001f }; //Corners closer than this to the camera plane can not be projected
+}
+
+void PrimaryRayContext::BuildTiles(const Matrix& cameraToWorld, float fovAngle, int width, int height)
+{
+	nrTilesX = (width + TileSize - 1) / TileSize;
+	nrTilesY = (height + TileSize - 1) / TileSize;
+
+	m_WorldToCamera = Matrix::Inverse(cameraToWorld);
+	m_Width = width;
+	m_Height = height;
+
+	//Inverse of the primary ray generation: camera space x / z = (2 * (px + 0.5) / width - 1) * aspectRatio * fov
+	const float fieldOfView{ tanf(fovAngle * TO_RADIANS * 0.5f) };
+	m_ScaleX = 1.f / (static_cast<float>(width) / static_cast<float>(height) * fieldOfView);
+	m_ScaleY = 1.f / fieldOfView;
+
+	m_SphereRects.resize(sphereBounds.size());
+	for (size_t index{}; index < sphereBounds.size(); ++index)
+	{
+		m_SphereRects[index] = GetTileRect(sphereBounds[index]);
+	}
+
+	m_MeshRects.resize(meshBounds.size());
+	for (size_t index{}; index < meshBounds.size(); ++index)
+	{
+		m_MeshRects[index] = GetTileRect(meshBounds[index]);
+	}
+
+	tiles.assign(nrTilesX * nrTilesY, Tile{});
+	FillTiles(m_SphereRects, tileSpheres, false);
+	FillTiles(m_MeshRects, tileMeshes, true);
+}
+
+PrimaryRayContext::TileRect PrimaryRayContext::GetTileRect(const Aabb& bounds) const
+{
+	const TileRect allTiles{ 0, 0, nrTilesX - 1, nrTilesY - 1 };
+	const TileRect noTiles{ 1, 1, 0, 0 };
+
+	float minX{ INFINITY }, minY{ INFINITY }, maxX{ -INFINITY }, maxY{ -INFINITY };
+	uint32_t nrBehind{};
+
+	for (int corner{}; corner < 8; ++corner)
+	{
+		const Vector3 point{ m_WorldToCamera.TransformPoint(
+			corner & 1 ? bounds.max.x : bounds.min.x,
+			corner & 2 ? bounds.max.y : bounds.min.y,
+			corner & 4 ? bounds.max.z : bounds.min.z) };
+
+		if (point.z < MinimumDepth)
+		{
+			++nrBehind;
+			continue;
+		}
+
+		const float px{ (point.x / point.z * m_ScaleX + 1.f) * 0.5f * m_Width - 0.5f };
+		const float py{ (1.f - point.y / point.z * m_ScaleY) * 0.5f * m_Height - 0.5f };
+
+		minX = std::min(minX, px);
+		maxX = std::max(maxX, px);
+		minY = std::min(minY, py);
+		maxY = std::max(maxY, py);
+	}
+
+	//Completely behind the camera, or crossing the camera plane (then it is not clipped, it just covers everything)
+	if (nrBehind == 8) return noTiles;
+	if (nrBehind > 0) return allTiles;
+
+	//One pixel margin for rounding
+	minX = std::floor(minX) - 1.f;
+	minY = std::floor(minY) - 1.f;
+	maxX = std::ceil(maxX) + 1.f;
+	maxY = std::ceil(maxY) + 1.f;
+
+	if (maxX < 0.f || maxY < 0.f || minX > m_Width - 1.f || minY > m_Height - 1.f) return noTiles;
+
+	return {
+		static_cast<uint32_t>(std::max(minX, 0.f)) / TileSize,
+		static_cast<uint32_t>(std::max(minY, 0.f)) / TileSize,
+		static_cast<uint32_t>(std::min(maxX, m_Width - 1.f)) / TileSize,
+		static_cast<uint32_t>(std::min(maxY, m_Height - 1.f)) / TileSize };
+}
+
+void PrimaryRayContext::FillTiles(const std::vector<TileRect>& rects, std::vector<uint32_t>& objects, bool isMesh)
+{
+	//Counting sort: count per tile, prefix sum to ranges, then fill in object order
+	m_TileCounts.assign(tiles.size(), 0);
+	for (const TileRect& rect : rects)
+	{
+		for (uint32_t y{ rect.minY }; y <= rect.maxY; ++y)
+		{
+			for (uint32_t x{ rect.minX }; x <= rect.maxX; ++x) ++m_TileCounts[y * nrTilesX + x];
+		}
+	}
+
+	uint32_t total{};
+	for (size_t tileIndex{}; tileIndex < tiles.size(); ++tileIndex)
+	{
+		Tile& tile{ tiles[tileIndex] };
+		(isMesh ? tile.firstMesh : tile.firstSphere) = total;
+		(isMesh ? tile.nrMeshes : tile.nrSpheres) = 0;
+		total += m_TileCounts[tileIndex];
+	}
+
+	objects.resize(total);
+	for (uint32_t objectIndex{}; objectIndex < rects.size(); ++objectIndex)
+	{
+		const TileRect& rect{ rects[objectIndex] };
+		for (uint32_t y{ rect.minY }; y <= rect.maxY; ++y)
+		{
+			for (uint32_t x{ rect.minX }; x <= rect.maxX; ++x)
+			{
+				Tile& tile{ tiles[y * nrTilesX + x] };
+				if (isMesh) objects[tile.firstMesh + tile.nrMeshes++] = objectIndex;
+				else objects[tile.firstSphere + tile.nrSpheres++] = objectIndex;
+			}
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Everything primary rays share, built once per frame for the camera (see Scene::UpdatePrimaryRayContext):
+	//- the terms of the sphere and plane tests that only depend on the ray origin, indexed like the spheres and planes of the scene
+	//- per screen tile the spheres and meshes whose projected bounding box overlaps it, the other objects can not be hit by its pixels
+	struct PrimaryRayContext
+	{
+		static constexpr uint32_t TileSize{ 16 }; //Pixels
+
+		struct SphereTerms
+		{
+			Vector3 originVector; //Ray origin - sphere origin
+			float c; //Dot(originVector, originVector) - radius²
+		};
+
+		//Ranges in tileSpheres and tileMeshes
+		struct Tile
+		{
+			uint32_t firstSphere, nrSpheres;
+			uint32_t firstMesh, nrMeshes;
+		};
+
+		Vector3 origin{};
+		std::vector<SphereTerms> spheres{};
+		std::vector<float> planeDistances{};
+
+		//World bounds, input of BuildTiles
+		std::vector<Aabb> sphereBounds{};
+		std::vector<Aabb> meshBounds{};
+
+		uint32_t nrTilesX{};
+		uint32_t nrTilesY{};
+		std::vector<Tile> tiles{};
+		std::vector<uint32_t> tileSpheres{};
+		std::vector<uint32_t> tileMeshes{};
+
+		//Inclusive tile range covered by an object, empty when minX > maxX
+		struct TileRect
+		{
+			uint32_t minX, minY, maxX, maxY;
+		};
+
+		uint32_t GetTileIndex(uint32_t px, uint32_t py) const { return (py / TileSize) * nrTilesX + px / TileSize; }
+
+		/**
+		 * \brief Projects sphereBounds and meshBounds to the screen and fills the tile lists
+		 * \param cameraToWorld Camera transform, its origin is the origin of the primary rays
+		 * \param fovAngle Vertical field of view in degrees, as used to generate the primary rays
+		 */
+		void BuildTiles(const Matrix& cameraToWorld, float fovAngle, int width, int height);
+
+		//Tiles covered by a world space box, with the camera of the last BuildTiles
+		TileRect GetTileRect(const Aabb& bounds) const;
+
+	private:
+		Matrix m_WorldToCamera{};
+		float m_ScaleX{};
+		float m_ScaleY{};
+		int m_Width{};
+		int m_Height{};
+
+		std::vector<TileRect> m_SphereRects{};
+		std::vector<TileRect> m_MeshRects{};
+		std::vector<uint32_t> m_TileCounts{};
+
+		void FillTiles(const std::vector<TileRect>& rects, std::vector<uint32_t>& objects, bool isMesh);
+	};
+}
@@ -0,0 +1,161 @@
+#include "PrimaryRayTable.h"
+
+#include <cstring>
+#include <ppl.h>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#include <immintrin.h>
+#define PRIMARY_RAY_SIMD
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+using namespace dae;
+
+#if defined(PRIMARY_RAY_SIMD)
+namespace dae
+{
+	//PrimaryRayTableAVX.cpp
+	uint32_t RotateDirectionsAVX(const float* const pCamera[3], float* const pWorld[3], float* const pInverse[3], const float axes[3][3], uint32_t first, uint32_t end);
+}
+#endif
+
+namespace
+{
+	constexpr uint32_t RotateBlockSize{ 4096 }; //Pixels per parallel task
+
+#if defined(PRIMARY_RAY_SIMD)
+	//The build only assumes SSE2, AVX is used when both the CPU and the OS (saving the ymm registers) support it
+	bool IsAVXSupported()
+	{
+		static const bool isSupported{ []
+			{
+#if defined(_MSC_VER)
+				int info[4]{};
+				__cpuid(info, 1);
+				const bool hasOSXSAVE{ (info[2] & (1 << 27)) != 0 };
+				const bool hasAVX{ (info[2] & (1 << 28)) != 0 };
+				return hasOSXSAVE && hasAVX && (_xgetbv(0) & 0x6) == 0x6;
+#else
+				return __builtin_cpu_supports("avx") != 0;
+#endif
+			}() };
+		return isSupported;
+	}
+#endif
+}
+
+void PrimaryRayTable::Update(int width, int height, float fovAngle, const Matrix& cameraToWorld)
+{
+	if (width != m_Width || height != m_Height || fovAngle != m_FovAngle)
+	{
+		m_Width = width;
+		m_Height = height;
+		m_FovAngle = fovAngle;
+
+		BuildCameraDirections();
+		m_IsRotated = false;
+	}
+
+	if (m_IsRotated && memcmp(&cameraToWorld, &m_CameraToWorld, sizeof(Matrix)) == 0) return;
+
+	m_CameraToWorld = cameraToWorld;
+	m_IsRotated = true;
+
+	const uint32_t nrPixels{ static_cast<uint32_t>(m_CameraX.size()) };
+	const uint32_t nrBlocks{ (nrPixels + RotateBlockSize - 1) / RotateBlockSize };
+
+	concurrency::parallel_for(0u, nrBlocks, [this, nrPixels](uint32_t block)
+		{
+			RotateDirections(block * RotateBlockSize, std::min((block + 1) * RotateBlockSize, nrPixels));
+		});
+}
+
+void PrimaryRayTable::BuildCameraDirections()
+{
+	const uint32_t nrPixels{ static_cast<uint32_t>(m_Width * m_Height) };
+
+	for (std::vector<float>* pComponent : { &m_CameraX, &m_CameraY, &m_CameraZ, &m_WorldX, &m_WorldY, &m_WorldZ, &m_InverseX, &m_InverseY, &m_InverseZ })
+	{
+		pComponent->resize(nrPixels);
+	}
+
+	const float aspectRatio{ static_cast<float>(m_Width) / static_cast<float>(m_Height) };
+	const float fieldOfView{ tanf(m_FovAngle * TO_RADIANS * 0.5f) };
+
+	for (uint32_t pixelIndex{}; pixelIndex < nrPixels; ++pixelIndex)
+	{
+		const uint32_t px{ pixelIndex % m_Width }, py{ pixelIndex / m_Width };
+
+		const float cx{ (((2.f * (px + 0.5f)) / static_cast<float>(m_Width)) - 1) * aspectRatio * fieldOfView };
+		const float cy{ (1 - ((2.f * (py + 0.5f)) / static_cast<float>(m_Height))) * fieldOfView };
+
+		const Vector3 direction{ Vector3{ cx, cy, 1.f }.Normalized() };
+
+		m_CameraX[pixelIndex] = direction.x;
+		m_CameraY[pixelIndex] = direction.y;
+		m_CameraZ[pixelIndex] = direction.z;
+	}
+}
+
+void PrimaryRayTable::RotateDirections(uint32_t first, uint32_t end)
+{
+	const Vector4 xAxis{ m_CameraToWorld[0] };
+	const Vector4 yAxis{ m_CameraToWorld[1] };
+	const Vector4 zAxis{ m_CameraToWorld[2] };
+
+	uint32_t pixelIndex{ first };
+
+#if defined(PRIMARY_RAY_SIMD)
+	if (IsAVXSupported())
+	{
+		const float* const pCamera[3]{ m_CameraX.data(), m_CameraY.data(), m_CameraZ.data() };
+		float* const pWorld[3]{ m_WorldX.data(), m_WorldY.data(), m_WorldZ.data() };
+		float* const pInverse[3]{ m_InverseX.data(), m_InverseY.data(), m_InverseZ.data() };
+		const float axes[3][3]{ { xAxis.x, xAxis.y, xAxis.z }, { yAxis.x, yAxis.y, yAxis.z }, { zAxis.x, zAxis.y, zAxis.z } };
+
+		pixelIndex = RotateDirectionsAVX(pCamera, pWorld, pInverse, axes, pixelIndex, end);
+	}
+
+	//4 directions at a time, what AVX left or everything without it
+	const __m128 m00{ _mm_set1_ps(xAxis.x) }, m01{ _mm_set1_ps(xAxis.y) }, m02{ _mm_set1_ps(xAxis.z) };
+	const __m128 m10{ _mm_set1_ps(yAxis.x) }, m11{ _mm_set1_ps(yAxis.y) }, m12{ _mm_set1_ps(yAxis.z) };
+	const __m128 m20{ _mm_set1_ps(zAxis.x) }, m21{ _mm_set1_ps(zAxis.y) }, m22{ _mm_set1_ps(zAxis.z) };
+	const __m128 one{ _mm_set1_ps(1.f) };
+
+	for (; pixelIndex + 4 <= end; pixelIndex += 4)
+	{
+		const __m128 x{ _mm_loadu_ps(&m_CameraX[pixelIndex]) };
+		const __m128 y{ _mm_loadu_ps(&m_CameraY[pixelIndex]) };
+		const __m128 z{ _mm_loadu_ps(&m_CameraZ[pixelIndex]) };
+
+		const __m128 worldX{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, x), _mm_mul_ps(m10, y)), _mm_mul_ps(m20, z)) };
+		const __m128 worldY{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, x), _mm_mul_ps(m11, y)), _mm_mul_ps(m21, z)) };
+		const __m128 worldZ{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, x), _mm_mul_ps(m12, y)), _mm_mul_ps(m22, z)) };
+
+		_mm_storeu_ps(&m_WorldX[pixelIndex], worldX);
+		_mm_storeu_ps(&m_WorldY[pixelIndex], worldY);
+		_mm_storeu_ps(&m_WorldZ[pixelIndex], worldZ);
+
+		//Exact division, the slab tests rely on infinities for axis aligned directions
+		_mm_storeu_ps(&m_InverseX[pixelIndex], _mm_div_ps(one, worldX));
+		_mm_storeu_ps(&m_InverseY[pixelIndex], _mm_div_ps(one, worldY));
+		_mm_storeu_ps(&m_InverseZ[pixelIndex], _mm_div_ps(one, worldZ));
+	}
+#endif
+
+	//Remainder, or everything without SIMD
+	for (; pixelIndex < end; ++pixelIndex)
+	{
+		const float x{ m_CameraX[pixelIndex] }, y{ m_CameraY[pixelIndex] }, z{ m_CameraZ[pixelIndex] };
+
+		m_WorldX[pixelIndex] = xAxis.x * x + yAxis.x * y + zAxis.x * z;
+		m_WorldY[pixelIndex] = xAxis.y * x + yAxis.y * y + zAxis.y * z;
+		m_WorldZ[pixelIndex] = xAxis.z * x + yAxis.z * y + zAxis.z * z;
+
+		m_InverseX[pixelIndex] = 1.f / m_WorldX[pixelIndex];
+		m_InverseY[pixelIndex] = 1.f / m_WorldY[pixelIndex];
+		m_InverseZ[pixelIndex] = 1.f / m_WorldZ[pixelIndex];
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	//Primary ray direction of every pixel, stored per component (SoA)
+	//The camera space directions only depend on the resolution and field of view, the world space directions and
+	//their reciprocals are rotated from them in one streaming pass when the camera rotates.
+	class PrimaryRayTable final
+	{
+	public:
+		PrimaryRayTable() = default;
+
+		PrimaryRayTable(const PrimaryRayTable&) = delete;
+		PrimaryRayTable(PrimaryRayTable&&) noexcept = delete;
+		PrimaryRayTable& operator=(const PrimaryRayTable&) = delete;
+		PrimaryRayTable& operator=(PrimaryRayTable&&) noexcept = delete;
+
+		//Call once per frame before rendering, only does work when something changed
+		void Update(int width, int height, float fovAngle, const Matrix& cameraToWorld);
+
+		Vector3 GetDirection(uint32_t pixelIndex) const { return { m_WorldX[pixelIndex], m_WorldY[pixelIndex], m_WorldZ[pixelIndex] }; }
+		Vector3 GetInverseDirection(uint32_t pixelIndex) const { return { m_InverseX[pixelIndex], m_InverseY[pixelIndex], m_InverseZ[pixelIndex] }; }
+
+	private:
+		int m_Width{};
+		int m_Height{};
+		float m_FovAngle{};
+		Matrix m_CameraToWorld{};
+		bool m_IsRotated{ false };
+
+		//Normalized, camera space
+		std::vector<float> m_CameraX{}, m_CameraY{}, m_CameraZ{};
+		//World space
+		std::vector<float> m_WorldX{}, m_WorldY{}, m_WorldZ{};
+		std::vector<float> m_InverseX{}, m_InverseY{}, m_InverseZ{};
+
+		void BuildCameraDirections();
+		void RotateDirections(uint32_t first, uint32_t end);
+	};
+}
@@ -0,0 +1,50 @@
+//The only file built with AVX (see the vcxproj), PrimaryRayTable.cpp calls it after checking the CPU.
+//Only raw pointers and intrinsics here: an inline function from a shared header compiled in this file could be the
+//copy the linker keeps for every caller, and run AVX instructions on CPUs without them.
+#include <cstdint>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#include <immintrin.h>
+
+#if defined(__GNUC__) && !defined(__AVX__)
+#define PRIMARY_RAY_AVX_TARGET __attribute__((target("avx")))
+#else
+#define PRIMARY_RAY_AVX_TARGET
+#endif
+
+namespace dae
+{
+	//Rotates 8 directions at a time from first, returns the first pixel left for the caller
+	PRIMARY_RAY_AVX_TARGET
+	uint32_t RotateDirectionsAVX(const float* const pCamera[3], float* const pWorld[3], float* const pInverse[3], const float axes[3][3], uint32_t first, uint32_t end)
+	{
+		const __m256 m00{ _mm256_set1_ps(axes[0][0]) }, m01{ _mm256_set1_ps(axes[0][1]) }, m02{ _mm256_set1_ps(axes[0][2]) };
+		const __m256 m10{ _mm256_set1_ps(axes[1][0]) }, m11{ _mm256_set1_ps(axes[1][1]) }, m12{ _mm256_set1_ps(axes[1][2]) };
+		const __m256 m20{ _mm256_set1_ps(axes[2][0]) }, m21{ _mm256_set1_ps(axes[2][1]) }, m22{ _mm256_set1_ps(axes[2][2]) };
+		const __m256 one{ _mm256_set1_ps(1.f) };
+
+		uint32_t pixelIndex{ first };
+		for (; pixelIndex + 8 <= end; pixelIndex += 8)
+		{
+			const __m256 x{ _mm256_loadu_ps(pCamera[0] + pixelIndex) };
+			const __m256 y{ _mm256_loadu_ps(pCamera[1] + pixelIndex) };
+			const __m256 z{ _mm256_loadu_ps(pCamera[2] + pixelIndex) };
+
+			const __m256 worldX{ _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, x), _mm256_mul_ps(m10, y)), _mm256_mul_ps(m20, z)) };
+			const __m256 worldY{ _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m01, x), _mm256_mul_ps(m11, y)), _mm256_mul_ps(m21, z)) };
+			const __m256 worldZ{ _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m02, x), _mm256_mul_ps(m12, y)), _mm256_mul_ps(m22, z)) };
+
+			_mm256_storeu_ps(pWorld[0] + pixelIndex, worldX);
+			_mm256_storeu_ps(pWorld[1] + pixelIndex, worldY);
+			_mm256_storeu_ps(pWorld[2] + pixelIndex, worldZ);
+
+			//Exact division, the slab tests rely on infinities for axis aligned directions
+			_mm256_storeu_ps(pInverse[0] + pixelIndex, _mm256_div_ps(one, worldX));
+			_mm256_storeu_ps(pInverse[1] + pixelIndex, _mm256_div_ps(one, worldY));
+			_mm256_storeu_ps(pInverse[2] + pixelIndex, _mm256_div_ps(one, worldZ));
+		}
+
+		return pixelIndex;
+	}
+}
+#endif
@@ -0,0 +1,293 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "SDL.h"
+
+using namespace dae;
+
+namespace
+{
+	uint32_t GetThreadId()
+	{
+		static std::atomic<uint32_t> nextThreadId{};
+		thread_local const uint32_t threadId{ nextThreadId++ };
+
+		return threadId;
+	}
+
+	struct StageStatistics
+	{
+		double min{};
+		double avg{};
+		double p95{};
+		double p99{};
+		double max{};
+	};
+
+	StageStatistics CalculateStatistics(std::vector<double>& values)
+	{
+		StageStatistics statistics{};
+		if (values.empty()) return statistics;
+
+		std::sort(values.begin(), values.end());
+
+		double total{};
+		for (const double value : values) total += value;
+
+		const auto percentile = [&](double fraction)
+		{
+			const size_t index{ static_cast<size_t>(fraction * static_cast<double>(values.size() - 1) + 0.5) };
+			return values[std::min(index, values.size() - 1)];
+		};
+
+		statistics.min = values.front();
+		statistics.avg = total / static_cast<double>(values.size());
+		statistics.p95 = percentile(0.95);
+		statistics.p99 = percentile(0.99);
+		statistics.max = values.back();
+
+		return statistics;
+	}
+}
+
+Profiler& Profiler::GetInstance()
+{
+	static Profiler profiler{};
+	return profiler;
+}
+
+Profiler::Profiler() :
+	m_MillisecondsPerTick{ 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency()) }
+{
+}
+
+uint64_t Profiler::GetTicks()
+{
+	return SDL_GetPerformanceCounter();
+}
+
+const char* Profiler::GetStageName(ProfileStage stage)
+{
+	switch (stage)
+	{
+	case ProfileStage::CameraUpdate: return "CameraUpdate";
+	case ProfileStage::SceneUpdate: return "SceneUpdate";
+	case ProfileStage::Render: return "Render";
+	case ProfileStage::PrimaryTrace: return "PrimaryTrace";
+	case ProfileStage::ShadowTrace: return "ShadowTrace";
+	case ProfileStage::Shading: return "Shading";
+	case ProfileStage::FramebufferConversion: return "FramebufferConversion";
+	case ProfileStage::Upscale: return "Upscale";
+	case ProfileStage::Present: return "Present";
+	default: return "Unknown";
+	}
+}
+
+bool Profiler::IsOverlapped(ProfileStage stage)
+{
+	switch (stage)
+	{
+	case ProfileStage::SceneUpdate:
+	case ProfileStage::PrimaryTrace:
+	case ProfileStage::ShadowTrace:
+	case ProfileStage::Shading:
+	case ProfileStage::FramebufferConversion:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void Profiler::StartCapture(uint32_t numFrames)
+{
+	std::lock_guard lock{ m_Mutex };
+
+	if (m_IsCapturing)
+	{
+		std::cout << "(Profiler capture already running)";
+		return;
+	}
+
+	m_CaptureFrames = numFrames;
+	m_Frames.clear();
+	m_Frames.reserve(numFrames);
+	m_Events.clear();
+	m_Events.reserve(numFrames * 16);
+
+	m_CaptureStartTicks = GetTicks();
+	m_CurrentFrame = FrameRecord{ m_CaptureStartTicks };
+	m_CurrentFrameFirstEvent = 0;
+	m_IsCapturing = true;
+
+	std::cout << "**PROFILER CAPTURE STARTED**\n";
+}
+
+void Profiler::BeginFrame()
+{
+	if (!m_IsCapturing) return;
+
+	std::lock_guard lock{ m_Mutex };
+	m_CurrentFrame = FrameRecord{ GetTicks() };
+	m_CurrentFrameFirstEvent = m_Events.size();
+}
+
+void Profiler::EndFrame()
+{
+	if (!m_IsCapturing) return;
+
+	{
+		std::lock_guard lock{ m_Mutex };
+
+		m_CurrentFrame.endTicks = GetTicks();
+		m_Frames.push_back(m_CurrentFrame);
+
+		if (m_Frames.size() < m_CaptureFrames) return;
+
+		m_IsCapturing = false;
+	}
+
+	FinishCapture();
+}
+
+void Profiler::DiscardFrame()
+{
+	if (!m_IsCapturing) return;
+
+	std::lock_guard lock{ m_Mutex };
+	m_Events.resize(m_CurrentFrameFirstEvent);
+}
+
+void Profiler::AddScopedTime(ProfileStage stage, uint64_t startTicks, uint64_t endTicks, uint64_t nestedTicks)
+{
+	if (!m_IsCapturing) return;
+
+	std::lock_guard lock{ m_Mutex };
+
+	m_CurrentFrame.stageTicks[static_cast<int>(stage)] += endTicks - startTicks - nestedTicks;
+	m_Events.push_back(TraceEvent{ stage, GetThreadId(), startTicks, endTicks });
+}
+
+void Profiler::AddStageTime(ProfileStage stage, uint64_t ticks)
+{
+	if (!m_IsCapturing) return;
+
+	std::lock_guard lock{ m_Mutex };
+	m_CurrentFrame.stageTicks[static_cast<int>(stage)] += ticks;
+}
+
+void Profiler::FinishCapture()
+{
+	WriteSummary("profile.json", "profile.csv");
+	WriteTrace("profile_trace.json");
+
+	std::cout << "**PROFILER CAPTURE FINISHED** (" << m_Frames.size() << " frames)\n";
+	std::cout << "Results written to profile.json, profile.csv and profile_trace.json\n";
+}
+
+void Profiler::WriteSummary(const std::string& jsonPath, const std::string& csvPath) const
+{
+	constexpr int numStages{ static_cast<int>(ProfileStage::Count) };
+
+	StageStatistics statistics[numStages + 1]{};
+	std::vector<double> values(m_Frames.size());
+
+	for (int stage{}; stage < numStages; ++stage)
+	{
+		for (size_t frame{}; frame < m_Frames.size(); ++frame)
+		{
+			values[frame] = static_cast<double>(m_Frames[frame].stageTicks[stage]) * m_MillisecondsPerTick;
+		}
+
+		statistics[stage] = CalculateStatistics(values);
+	}
+
+	//Last row is the full frame
+	for (size_t frame{}; frame < m_Frames.size(); ++frame)
+	{
+		values[frame] = static_cast<double>(m_Frames[frame].endTicks - m_Frames[frame].startTicks) * m_MillisecondsPerTick;
+	}
+	statistics[numStages] = CalculateStatistics(values);
+
+	const auto getName = [](int stage) { return stage == numStages ? "Frame" : GetStageName(static_cast<ProfileStage>(stage)); };
+
+	const auto isOverlapped = [](int stage) { return stage != numStages && IsOverlapped(static_cast<ProfileStage>(stage)); };
+
+	std::ofstream csvStream(csvPath);
+	csvStream << "stage,overlapped,min_ms,avg_ms,p95_ms,p99_ms,max_ms\n";
+
+	std::ofstream jsonStream(jsonPath);
+	jsonStream << "{\n\t\"frames\": " << m_Frames.size() << ",\n\t\"stages\": {\n";
+
+	std::cout << "stage                  min      avg      p95      p99   (ms, * overlapped: not part of the frame time sum)\n";
+
+	for (int stage{}; stage <= numStages; ++stage)
+	{
+		const StageStatistics& stats{ statistics[stage] };
+
+		csvStream << getName(stage) << ',' << (isOverlapped(stage) ? 1 : 0) << ',' << stats.min << ',' << stats.avg << ',' << stats.p95 << ',' << stats.p99 << ',' << stats.max << '\n';
+
+		jsonStream << "\t\t\"" << getName(stage) << "\": { \"overlapped\": " << (isOverlapped(stage) ? "true" : "false") << ", \"min\": " << stats.min << ", \"avg\": " << stats.avg
+			<< ", \"p95\": " << stats.p95 << ", \"p99\": " << stats.p99 << ", \"max\": " << stats.max << " }"
+			<< (stage < numStages ? ",\n" : "\n");
+
+		std::printf("%-21s%c %8.3f %8.3f %8.3f %8.3f\n", getName(stage), isOverlapped(stage) ? '*' : ' ', stats.min, stats.avg, stats.p95, stats.p99);
+	}
+
+	jsonStream << "\t}\n}\n";
+}
+
+void Profiler::WriteTrace(const std::string& path) const
+{
+	constexpr int numStages{ static_cast<int>(ProfileStage::Count) };
+	const double microsecondsPerTick{ m_MillisecondsPerTick * 1000.0 };
+
+	const auto toMicroseconds = [&](uint64_t ticks)
+	{
+		return static_cast<double>(ticks - m_CaptureStartTicks) * microsecondsPerTick;
+	};
+
+	std::ofstream stream(path);
+	stream << "{\"traceEvents\":[\n";
+
+	bool isFirst{ true };
+	const auto separator = [&]() -> const char*
+	{
+		if (isFirst)
+		{
+			isFirst = false;
+			return "";
+		}
+		return ",\n";
+	};
+
+	for (size_t frame{}; frame < m_Frames.size(); ++frame)
+	{
+		const FrameRecord& record{ m_Frames[frame] };
+
+		stream << separator() << "{\"name\":\"Frame " << frame << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":"
+			<< toMicroseconds(record.startTicks) << ",\"dur\":" << static_cast<double>(record.endTicks - record.startTicks) * microsecondsPerTick << "}";
+
+		//Stages accumulated over threads have no single start, they are shown as counters
+		stream << separator() << "{\"name\":\"Pixel stages (ms)\",\"ph\":\"C\",\"pid\":0,\"ts\":" << toMicroseconds(record.startTicks) << ",\"args\":{";
+		for (int stage{ static_cast<int>(ProfileStage::PrimaryTrace) }; stage <= static_cast<int>(ProfileStage::FramebufferConversion); ++stage)
+		{
+			stream << (stage == static_cast<int>(ProfileStage::PrimaryTrace) ? "" : ",") << '"' << GetStageName(static_cast<ProfileStage>(stage)) << "\":"
+				<< static_cast<double>(record.stageTicks[stage]) * m_MillisecondsPerTick;
+		}
+		stream << "}}";
+	}
+
+	for (const TraceEvent& event : m_Events)
+	{
+		if (static_cast<int>(event.stage) >= numStages) continue;
+
+		stream << separator() << "{\"name\":\"" << GetStageName(event.stage) << "\",\"cat\":\"stage\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.threadId + 1
+			<< ",\"ts\":" << toMicroseconds(event.startTicks) << ",\"dur\":" << static_cast<double>(event.endTicks - event.startTicks) * microsecondsPerTick << "}";
+	}
+
+	stream << "\n]}\n";
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//Comment out to compile every profiler scope and the pixel stage timing of the renderer away
+#define ENABLE_PROFILER
+
+namespace dae
+{
+	enum class ProfileStage
+	{
+		CameraUpdate,
+		SceneUpdate, //Mesh transforms + BVH refit, overlapped: runs on a worker during Render (see Scene::SetPipelined)
+		Render, //Wall time of the whole pixel loop
+		PrimaryTrace, //Pixel stages: CPU time summed over all threads, estimated from sampled pixels
+		ShadowTrace,
+		Shading,
+		FramebufferConversion,
+		Upscale, //Dynamic resolution, render buffer to window
+		Present,
+
+		Count
+	};
+
+	//Per stage timings of every frame during a capture, reported as min/avg/p95/p99
+	//Stage times are exclusive, a scope nested in another one on the same thread only counts for the nested stage.
+	//Overlapped stages (see IsOverlapped) run at the same time as others, only the remaining stages add up to the frame.
+	//Results are written to profile.json, profile.csv and profile_trace.json (chrome://tracing)
+	class Profiler final
+	{
+	public:
+		static Profiler& GetInstance();
+
+		Profiler(const Profiler&) = delete;
+		Profiler(Profiler&&) noexcept = delete;
+		Profiler& operator=(const Profiler&) = delete;
+		Profiler& operator=(Profiler&&) noexcept = delete;
+
+		void StartCapture(uint32_t numFrames = 200);
+		bool IsCapturing() const { return m_IsCapturing; }
+
+		void BeginFrame();
+		void EndFrame();
+		//Ends the frame without recording it, for iterations that did not render anything
+		void DiscardFrame();
+
+		//Stage with a start and end on one thread, shows up in the trace
+		//nestedTicks: time in that span already counted for nested stages
+		void AddScopedTime(ProfileStage stage, uint64_t startTicks, uint64_t endTicks, uint64_t nestedTicks = 0);
+		//Stage time accumulated elsewhere (e.g. summed over threads)
+		void AddStageTime(ProfileStage stage, uint64_t ticks);
+
+		static uint64_t GetTicks();
+		static const char* GetStageName(ProfileStage stage);
+		//Stages that run in parallel with other stages, CPU time of the pixel stages is summed over threads and spent during Render
+		static bool IsOverlapped(ProfileStage stage);
+
+	private:
+		Profiler();
+		~Profiler() = default;
+
+		struct TraceEvent
+		{
+			ProfileStage stage;
+			uint32_t threadId;
+			uint64_t startTicks;
+			uint64_t endTicks;
+		};
+
+		struct FrameRecord
+		{
+			uint64_t startTicks{};
+			uint64_t endTicks{};
+			uint64_t stageTicks[static_cast<int>(ProfileStage::Count)]{};
+		};
+
+		std::mutex m_Mutex{};
+
+		std::atomic<bool> m_IsCapturing{ false };
+		uint32_t m_CaptureFrames{};
+		uint64_t m_CaptureStartTicks{};
+		double m_MillisecondsPerTick{};
+
+		FrameRecord m_CurrentFrame{};
+		size_t m_CurrentFrameFirstEvent{};
+		std::vector<FrameRecord> m_Frames{};
+		std::vector<TraceEvent> m_Events{};
+
+		void FinishCapture();
+		void WriteSummary(const std::string& jsonPath, const std::string& csvPath) const;
+		void WriteTrace(const std::string& path) const;
+	};
+
+	class ScopedTimer final
+	{
+	public:
+		explicit ScopedTimer(ProfileStage stage) :
+			m_Stage{ stage },
+			m_pParent{ s_pCurrent },
+			m_StartTicks{ Profiler::GetTicks() }
+		{
+			s_pCurrent = this;
+		}
+
+		~ScopedTimer()
+		{
+			const uint64_t endTicks{ Profiler::GetTicks() };
+
+			s_pCurrent = m_pParent;
+			if (m_pParent) m_pParent->m_NestedTicks += endTicks - m_StartTicks;
+
+			Profiler::GetInstance().AddScopedTime(m_Stage, m_StartTicks, endTicks, m_NestedTicks);
+		}
+
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer(ScopedTimer&&) noexcept = delete;
+		ScopedTimer& operator=(const ScopedTimer&) = delete;
+		ScopedTimer& operator=(ScopedTimer&&) noexcept = delete;
+
+	private:
+		//Innermost scope of this thread, nested scopes subtract their time from it
+		inline static thread_local ScopedTimer* s_pCurrent{};
+
+		ProfileStage m_Stage;
+		ScopedTimer* m_pParent;
+		uint64_t m_StartTicks;
+		uint64_t m_NestedTicks{};
+	};
+}
+
+#if defined(ENABLE_PROFILER)
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(stage) dae::ScopedTimer PROFILE_CONCAT(scopedTimer, __LINE__){ stage }
+#else
+#define PROFILE_SCOPE(stage)
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+
+//Uncomment to count the traversal work of every ray, needed for the heatmap (F5)
+//#define RAY_STATISTICS
+
+namespace dae
+{
+	enum class RayType
+	{
+		Primary,
+		Shadow,
+
+		Count
+	};
+
+	//Work done by the intersection code, counted per thread and summed per frame by the renderer
+	struct RayStatistics
+	{
+		uint64_t rays[static_cast<int>(RayType::Count)]{};
+		uint64_t hits[static_cast<int>(RayType::Count)]{};
+		uint64_t nodesVisited{}; //BVH nodes whose bounding box was tested
+		uint64_t leavesVisited{}; //BVH leaves whose triangles were tested
+		uint64_t triangleTests{};
+		uint64_t sphereTests{};
+
+		RayStatistics& operator+=(const RayStatistics& other)
+		{
+			for (int type{}; type < static_cast<int>(RayType::Count); ++type)
+			{
+				rays[type] += other.rays[type];
+				hits[type] += other.hits[type];
+			}
+
+			nodesVisited += other.nodesVisited;
+			leavesVisited += other.leavesVisited;
+			triangleTests += other.triangleTests;
+			sphereTests += other.sphereTests;
+
+			return *this;
+		}
+
+		RayStatistics& operator-=(const RayStatistics& other)
+		{
+			for (int type{}; type < static_cast<int>(RayType::Count); ++type)
+			{
+				rays[type] -= other.rays[type];
+				hits[type] -= other.hits[type];
+			}
+
+			nodesVisited -= other.nodesVisited;
+			leavesVisited -= other.leavesVisited;
+			triangleTests -= other.triangleTests;
+			sphereTests -= other.sphereTests;
+
+			return *this;
+		}
+
+		//Cost used by the heatmap
+		uint64_t GetCost() const { return nodesVisited + triangleTests + sphereTests; }
+
+		uint64_t GetTotalRays() const { return rays[static_cast<int>(RayType::Primary)] + rays[static_cast<int>(RayType::Shadow)]; }
+
+		static RayStatistics& GetThreadLocal()
+		{
+			thread_local RayStatistics statistics{};
+			return statistics;
+		}
+	};
+}
+
+#if defined(RAY_STATISTICS)
+#define RAY_STATISTIC(counter) ++dae::RayStatistics::GetThreadLocal().counter
+#define RAY_STATISTIC_RAY(type, didHit) { dae::RayStatistics& rayStatistics{ dae::RayStatistics::GetThreadLocal() }; ++rayStatistics.rays[static_cast<int>(type)]; if (didHit) ++rayStatistics.hits[static_cast<int>(type)]; }
+#else
+#define RAY_STATISTIC(counter)
+#define RAY_STATISTIC_RAY(type, didHit)
+#endif
@@ -0,0 +1,280 @@
+#include "RenderThread.h"
+#include "SDL.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "Profiler.h"
+#include "RayStatistics.h"
+#include "Scene.h"
+
+using namespace dae;
+
+namespace
+{
+	//While nothing changes no frames are rendered, an animated scene is updated again after this long so its animation starts again
+	constexpr std::chrono::milliseconds AnimationIdleWait{ 100 };
+}
+
+RenderThread::RenderThread(Scene* pScene, int width, int height) :
+	m_pScene{ pScene },
+	m_Renderer{ width, height },
+	m_Width{ width },
+	m_Height{ height },
+	m_FrameEventType{ SDL_RegisterEvents(1) }
+{
+	//The camera comes from the input thread
+	m_pScene->GetCamera().inputEnabled = false;
+
+	//The next frame's animation is updated while the current one is traced
+	m_pScene->SetPipelined(true);
+}
+
+RenderThread::~RenderThread()
+{
+	Stop();
+}
+
+void RenderThread::Start()
+{
+	if (m_IsRunning) return;
+
+	m_IsRunning = true;
+	if (m_pScene->IsAnimated()) m_UpdateThread = std::thread{ &RenderThread::RunSceneUpdates, this };
+	m_Thread = std::thread{ &RenderThread::Run, this };
+}
+
+void RenderThread::Stop()
+{
+	m_IsRunning = false;
+	Wake();
+	if (m_Thread.joinable()) m_Thread.join();
+
+	//The render thread waited for its last update, the update thread is idle
+	{
+		const std::lock_guard lock{ m_UpdateMutex };
+	}
+	m_UpdateCondition.notify_all();
+	if (m_UpdateThread.joinable()) m_UpdateThread.join();
+}
+
+void RenderThread::SetCamera(const Camera& camera)
+{
+	m_Cameras.GetWriteBuffer() = camera;
+	m_Cameras.Publish();
+	Wake();
+}
+
+void RenderThread::Post(std::function<void(Renderer&)> command)
+{
+	{
+		const std::lock_guard lock{ m_CommandMutex };
+		m_Commands.push_back(std::move(command));
+	}
+	Wake();
+}
+
+void RenderThread::RequestScreenshot()
+{
+	m_IsScreenshotRequested = true;
+	Wake();
+}
+
+void RenderThread::ToggleDynamicResolution()
+{
+	Post([this](Renderer& renderer)
+		{
+			m_DynamicResolution.SetEnabled(!m_DynamicResolution.IsEnabled());
+			renderer.SetResolutionScale(m_DynamicResolution.GetScale());
+			std::cout << "Dynamic resolution " << (m_DynamicResolution.IsEnabled() ? "on" : "off") << std::endl;
+		});
+}
+
+void RenderThread::StartProfileCapture()
+{
+	Post([this](Renderer&)
+		{
+			m_Timer.StartBenchmark();
+			Profiler::GetInstance().StartCapture();
+		});
+}
+
+void RenderThread::Run()
+{
+	m_Timer.Start();
+
+	bool isIdle{ false };
+	while (m_IsRunning)
+	{
+		WaitForWork(isIdle);
+		if (!m_IsRunning) break;
+
+		Profiler::GetInstance().BeginFrame();
+
+		RunCommands();
+
+		//Latched as late as possible, right before the frame
+		if (m_Cameras.Acquire())
+		{
+			Camera& camera{ m_pScene->GetCamera() };
+			camera = m_Cameras.GetReadBuffer();
+			camera.inputEnabled = false;
+		}
+
+		//Makes the meshes updated during the previous frame current, then updates them for the next one on a worker.
+		//Animation therefore shows up one frame later, the renderer never sees a half updated mesh or BVH.
+		//Update only animates, the other scenes have nothing to update.
+		m_pScene->SwapDynamicState();
+		const bool isUpdating{ m_UpdateThread.joinable() };
+		if (isUpdating) StartSceneUpdate();
+
+		const bool isFrameRendered{ m_Renderer.Render(m_pScene) };
+		if (isFrameRendered) PublishFrame();
+		SaveScreenshot();
+
+		//The update reads the timer
+		if (isUpdating) WaitForSceneUpdate();
+
+		//Frames after an idle wait are not timed by the dynamic resolution, the wait is in their elapsed time
+		m_Timer.Update();
+		if (isFrameRendered && !isIdle && m_DynamicResolution.Update(m_Timer.GetElapsed()))
+			m_Renderer.SetResolutionScale(m_DynamicResolution.GetScale());
+
+		m_PrintTimer += m_Timer.GetElapsed();
+		if (m_PrintTimer >= 1.f)
+		{
+			m_PrintTimer = 0.f;
+			std::cout << "dFPS: " << m_Timer.GetdFPS() << std::endl;
+
+			if (m_DynamicResolution.IsEnabled())
+				std::cout << "Render resolution: " << m_Renderer.GetRenderWidth() << "x" << m_Renderer.GetRenderHeight() << std::endl;
+
+#if defined(RAY_STATISTICS)
+			const RayStatistics& rayStatistics{ m_Renderer.GetRayStatistics() };
+			const double inverseRays{ 1.0 / std::max(rayStatistics.GetTotalRays(), uint64_t{ 1 }) };
+			std::cout << "Rays: " << rayStatistics.rays[static_cast<int>(RayType::Primary)] << " primary, "
+				<< rayStatistics.rays[static_cast<int>(RayType::Shadow)] << " shadow | per ray: "
+				<< rayStatistics.nodesVisited * inverseRays << " nodes, "
+				<< rayStatistics.leavesVisited * inverseRays << " leaves, "
+				<< rayStatistics.triangleTests * inverseRays << " triangles, "
+				<< rayStatistics.sphereTests * inverseRays << " spheres" << std::endl;
+#endif
+		}
+
+		//Idle iterations would fill the percentiles with empty frames
+		if (isFrameRendered) Profiler::GetInstance().EndFrame();
+		else Profiler::GetInstance().DiscardFrame();
+
+		isIdle = !isFrameRendered;
+	}
+
+	m_Timer.Stop();
+}
+
+void RenderThread::Wake()
+{
+	{
+		const std::lock_guard lock{ m_WakeMutex };
+		m_IsWakeRequested = true;
+	}
+	m_WakeCondition.notify_one();
+}
+
+void RenderThread::WaitForWork(bool isIdle)
+{
+	std::unique_lock lock{ m_WakeMutex };
+
+	//Wakes during a frame are for changes the next frame picks up anyway, so they are only checked while idle
+	if (isIdle)
+	{
+		const auto isWoken{ [this] { return m_IsWakeRequested || !m_IsRunning; } };
+
+		if (m_pScene->IsAnimated()) m_WakeCondition.wait_for(lock, AnimationIdleWait, isWoken);
+		else m_WakeCondition.wait(lock, isWoken);
+	}
+
+	m_IsWakeRequested = false;
+}
+
+void RenderThread::RunSceneUpdates()
+{
+	std::unique_lock lock{ m_UpdateMutex };
+
+	while (true)
+	{
+		m_UpdateCondition.wait(lock, [this] { return m_IsUpdatePending || !m_IsRunning; });
+		if (!m_IsUpdatePending) return;
+
+		lock.unlock();
+		{
+			PROFILE_SCOPE(ProfileStage::SceneUpdate);
+			m_pScene->Update(&m_Timer);
+		}
+		lock.lock();
+
+		m_IsUpdatePending = false;
+		m_UpdateCondition.notify_all();
+	}
+}
+
+void RenderThread::StartSceneUpdate()
+{
+	{
+		const std::lock_guard lock{ m_UpdateMutex };
+		m_IsUpdatePending = true;
+	}
+	m_UpdateCondition.notify_all();
+}
+
+void RenderThread::WaitForSceneUpdate()
+{
+	std::unique_lock lock{ m_UpdateMutex };
+	m_UpdateCondition.wait(lock, [this] { return !m_IsUpdatePending; });
+}
+
+void RenderThread::RunCommands()
+{
+	{
+		const std::lock_guard lock{ m_CommandMutex };
+		m_RunningCommands.swap(m_Commands);
+	}
+
+	for (const std::function<void(Renderer&)>& command : m_RunningCommands)
+	{
+		command(m_Renderer);
+	}
+	m_RunningCommands.clear();
+}
+
+//Publishes the frame, also when a budgeted frame is not finished yet
+void RenderThread::PublishFrame()
+{
+	std::vector<uint32_t>& frame{ m_Frames.GetWriteBuffer() };
+	const uint32_t* pPixels{ m_Renderer.GetBufferPixels() };
+
+	frame.assign(pPixels, pPixels + m_Width * m_Height);
+	m_Frames.Publish();
+
+	//Wakes the input thread to present it
+	if (m_FrameEventType != static_cast<uint32_t>(-1))
+	{
+		SDL_Event event{};
+		event.type = m_FrameEventType;
+		SDL_PushEvent(&event);
+	}
+}
+
+//Also when the frame was finished before the request, nothing is rendered then
+void RenderThread::SaveScreenshot()
+{
+	//Save screenshot after full render
+	if (m_IsScreenshotRequested && m_Renderer.IsFrameComplete())
+	{
+		if (!m_Renderer.SaveBufferToImage())
+			std::cout << "Screenshot saved!" << std::endl;
+		else
+			std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
+		m_IsScreenshotRequested = false;
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Camera.h"
+#include "DynamicResolution.h"
+#include "Renderer.h"
+#include "Timer.h"
+#include "TripleBuffer.h"
+
+namespace dae
+{
+	class Scene;
+
+	//Updates the scene and renders on its own thread, so the thread handling input and presenting never waits for a frame
+	//- the input thread publishes its camera, the render thread takes the newest one right before every frame
+	//- finished frames are published the same way, the input thread presents the newest one
+	//- everything else for the renderer is posted as a command, run by the render thread between frames
+	//- when nothing changes the render thread sleeps until one of these wakes it, animated scenes also after a timeout
+	class RenderThread final
+	{
+	public:
+		//The scene has to be initialized, from then on only the render thread uses it until Stop
+		RenderThread(Scene* pScene, int width, int height);
+		~RenderThread();
+
+		RenderThread(const RenderThread&) = delete;
+		RenderThread(RenderThread&&) noexcept = delete;
+		RenderThread& operator=(const RenderThread&) = delete;
+		RenderThread& operator=(RenderThread&&) noexcept = delete;
+
+		void Start();
+		void Stop();
+
+		//Input thread
+		void SetCamera(const Camera& camera);
+		void Post(std::function<void(Renderer&)> command);
+		void ToggleDynamicResolution();
+		void StartProfileCapture();
+		void RequestScreenshot();
+
+		//Pushed to the SDL event queue for every published frame, so the input thread can wait for events
+		uint32_t GetFrameEventType() const { return m_FrameEventType; }
+		//Input thread, returns false when no new frame was finished since the last call
+		bool AcquireFrame() { return m_Frames.Acquire(); }
+		//ARGB8888, the size of the render thread's output
+		uint32_t* GetFramePixels() { return m_Frames.GetReadBuffer().data(); }
+
+	private:
+		Scene* m_pScene;
+		Renderer m_Renderer;
+		const int m_Width;
+		const int m_Height;
+
+		//Owned by the render thread
+		Timer m_Timer{};
+		DynamicResolution m_DynamicResolution{ 1.f / 60.f };
+		float m_PrintTimer{};
+
+		TripleBuffer<Camera> m_Cameras{};
+		TripleBuffer<std::vector<uint32_t>> m_Frames{};
+
+		std::mutex m_CommandMutex{};
+		std::vector<std::function<void(Renderer&)>> m_Commands{};
+		std::vector<std::function<void(Renderer&)>> m_RunningCommands{};
+
+		std::mutex m_WakeMutex{};
+		std::condition_variable m_WakeCondition{};
+		bool m_IsWakeRequested{ false };
+		uint32_t m_FrameEventType{};
+
+		std::atomic<bool> m_IsScreenshotRequested{ false };
+		std::atomic<bool> m_IsRunning{ false };
+		std::thread m_Thread{};
+
+		//Animated scenes update the next frame on this thread while the render thread renders (see Scene::SetPipelined)
+		//It lives as long as the render thread, so a frame starts the update without allocating
+		std::thread m_UpdateThread{};
+		std::mutex m_UpdateMutex{};
+		std::condition_variable m_UpdateCondition{};
+		bool m_IsUpdatePending{ false }; //Started and not finished
+
+		void Run();
+		void Wake();
+		//Render thread, blocks while idle until woken, then consumes the wake
+		void WaitForWork(bool isIdle);
+		void RunCommands();
+		void RunSceneUpdates();
+		void StartSceneUpdate();
+		void WaitForSceneUpdate();
+		void PublishFrame();
+		void SaveScreenshot();
+	};
+}
@@ -9,7 +9,14 @@
 #include "Material.h"
 #include "Scene.h"
 #include "Utils.h"
-
+#include "LightTree.h"
+#include "Profiler.h"
+#include "Arena.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
 #include <thread>
 #include <future> //Async
 #include <ppl.h>
@@ -19,55 +26,297 @@ using namespace dae;
 //#define ASYNC
 #define PARALLEL_FOR
 
+#if defined(ENABLE_PROFILER)
+#define PIXEL_STAGE_END(stage) stageTimer.EndStage(stage)
+#else
+#define PIXEL_STAGE_END(stage)
+#endif
+
+namespace
+{
+#if defined(ENABLE_PROFILER)
+	//Adds the time since the previous stage of a sampled pixel, does nothing for pixels that are not sampled
+	class PixelStageTimer final
+	{
+	public:
+		explicit PixelStageTimer(uint64_t* pStageTicks) :
+			m_pStageTicks{ pStageTicks },
+			m_StartTicks{ pStageTicks ? Profiler::GetTicks() : 0 }
+		{
+		}
+
+		void EndStage(ProfileStage stage)
+		{
+			if (!m_pStageTicks) return;
+
+			const uint64_t ticks{ Profiler::GetTicks() };
+			m_pStageTicks[static_cast<int>(stage) - static_cast<int>(ProfileStage::PrimaryTrace)] += ticks - m_StartTicks;
+			m_StartTicks = ticks;
+		}
+
+	private:
+		uint64_t* m_pStageTicks;
+		uint64_t m_StartTicks;
+	};
+#endif
+
+	//Whether an occluder can shadow anything in receiver from the light, with bounding spheres and the cones of the light around them
+	bool CanCastShadow(const Light& light, const Aabb& occluder, const Aabb& receiver)
+	{
+		const Vector3 occluderCenter{ (occluder.min + occluder.max) * 0.5f };
+		const Vector3 receiverCenter{ (receiver.min + receiver.max) * 0.5f };
+		const float occluderRadius{ (occluder.max - occluder.min).Magnitude() * 0.5f };
+		const float receiverRadius{ (receiver.max - receiver.min).Magnitude() * 0.5f + 0.001f }; //Shadow rays start slightly above the hit points
+
+		//Directional light: the shadow is inside the cylinder around the occluder along the light direction
+		if (light.type == LightType::Directional)
+		{
+			const Vector3 offset{ receiverCenter - occluderCenter };
+			const float distanceAlongLight{ Vector3::Dot(offset, light.direction) };
+
+			if (distanceAlongLight < -(occluderRadius + receiverRadius)) return false;
+			return (offset - light.direction * distanceAlongLight).Magnitude() <= occluderRadius + receiverRadius;
+		}
+
+		//Point light: the shadow is inside the cone from the light around the occluder, beyond the occluder
+		const Vector3 toOccluder{ occluderCenter - light.origin };
+		const Vector3 toReceiver{ receiverCenter - light.origin };
+		const float occluderDistance{ toOccluder.Magnitude() };
+		const float receiverDistance{ toReceiver.Magnitude() };
+
+		if (occluderDistance <= occluderRadius || receiverDistance <= receiverRadius) return true;
+		if (occluderDistance - occluderRadius > receiverDistance + receiverRadius) return false;
+
+		const float coneAngles{ asinf(occluderRadius / occluderDistance) + asinf(receiverRadius / receiverDistance) };
+		if (coneAngles >= PI) return true;
+
+		const float cosAngle{ std::clamp(Vector3::Dot(toOccluder, toReceiver) / (occluderDistance * receiverDistance), -1.f, 1.f) };
+		return acosf(cosAngle) <= coneAngles;
+	}
+
+	//Interpolates the four 8 bit channels of two pixels at once, weight of b in 1/256
+	uint32_t LerpPixel(uint32_t a, uint32_t b, uint32_t weight)
+	{
+		const uint32_t redBlue{ (((a & 0x00FF00FF) * (256 - weight) + (b & 0x00FF00FF) * weight) >> 8) & 0x00FF00FF };
+		const uint32_t alphaGreen{ (((a >> 8) & 0x00FF00FF) * (256 - weight) + ((b >> 8) & 0x00FF00FF) * weight) & 0xFF00FF00 };
+
+		return redBlue | alphaGreen;
+	}
+
+	//Blue (cheap) - cyan - green - yellow - red (expensive)
+	ColorRGB GetHeatmapColor(float value)
+	{
+		const float scaled{ std::clamp(value, 0.f, 1.f) * 4.f };
+
+		if (scaled < 1.f) return { 0.f, scaled, 1.f };
+		if (scaled < 2.f) return { 0.f, 1.f, 2.f - scaled };
+		if (scaled < 3.f) return { scaled - 2.f, 1.f, 0.f };
+		return { 1.f, 4.f - scaled, 0.f };
+	}
+}
+
 Renderer::Renderer(SDL_Window * pWindow) :
 	m_pWindow(pWindow),
 	m_pBuffer(SDL_GetWindowSurface(pWindow))
 {
-	//Initialize
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
-	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
-	m_AspectRatio = static_cast<float>(m_Width) / static_cast<float>(m_Height);
+	Initialize();
+}
+
+Renderer::Renderer(int width, int height) :
+	m_pBuffer(SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888)),
+	m_OwnsBuffer(true),
+	m_Width(width),
+	m_Height(height)
+{
+	Initialize();
+}
+
+Renderer::~Renderer()
+{
+	if (m_OwnsBuffer)
+		SDL_FreeSurface(m_pBuffer);
+}
+
+void Renderer::Initialize()
+{
+	m_OutputWidth = m_Width;
+	m_OutputHeight = m_Height;
+
+	UpdateRenderBuffer();
+}
+
+void Renderer::SetResolutionScale(float scale)
+{
+	m_ResolutionScale = std::clamp(scale, 0.f, 1.f);
+
+	const int width{ std::max(static_cast<int>(m_OutputWidth * m_ResolutionScale + 0.5f), 1) };
+	const int height{ std::max(static_cast<int>(m_OutputHeight * m_ResolutionScale + 0.5f), 1) };
+	if (width == m_Width && height == m_Height) return;
+
+	m_Width = width;
+	m_Height = height;
+	UpdateRenderBuffer();
+
+	m_IsFrameDirty = true;
+}
+
+//At the output resolution the pixels are written straight into the surface
+void Renderer::UpdateRenderBuffer()
+{
 	m_NumberOfPixels = m_Width * m_Height;
+
+	if (m_Width == m_OutputWidth && m_Height == m_OutputHeight)
+	{
+		m_ScaledPixels.clear();
+		m_ScaledPixels.shrink_to_fit();
+		m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+	}
+	else
+	{
+		m_ScaledPixels.resize(m_NumberOfPixels);
+		m_pBufferPixels = m_ScaledPixels.data();
+
+		CalculateUpscaleTaps(m_Width, m_OutputWidth, m_UpscaleColumns);
+		CalculateUpscaleTaps(m_Height, m_OutputHeight, m_UpscaleRows);
+	}
+
+#if defined(RAY_STATISTICS)
+	m_PixelCosts.assign(m_NumberOfPixels, 0);
+#endif
 }
 
-void Renderer::Render(Scene* pScene) const
+//Pixel centers of the output mapped onto the render buffer, clamped at the edges
+void Renderer::CalculateUpscaleTaps(uint32_t sourceSize, uint32_t targetSize, std::vector<UpscaleTaps>& taps)
 {
+	taps.resize(targetSize);
+
+	const float ratio{ static_cast<float>(sourceSize) / static_cast<float>(targetSize) };
+	for (uint32_t index{}; index < targetSize; ++index)
+	{
+		const float position{ std::clamp((index + 0.5f) * ratio - 0.5f, 0.f, static_cast<float>(sourceSize - 1)) };
+		const uint32_t first{ static_cast<uint32_t>(position) };
+
+		taps[index] = UpscaleTaps{ first, std::min(first + 1, sourceSize - 1), static_cast<uint32_t>((position - first) * 256.f + 0.5f) };
+	}
+}
+
+void Renderer::Upscale()
+{
+	PROFILE_SCOPE(ProfileStage::Upscale);
+
+	uint32_t* pOutputPixels{ static_cast<uint32_t*>(m_pBuffer->pixels) };
+
+	concurrency::parallel_for(0, m_OutputHeight, [=, this](int y)
+		{
+			const UpscaleTaps& row{ m_UpscaleRows[y] };
+			const uint32_t* pFirstRow{ m_ScaledPixels.data() + row.first * m_Width };
+			const uint32_t* pSecondRow{ m_ScaledPixels.data() + row.second * m_Width };
+			uint32_t* pOutputRow{ pOutputPixels + y * m_OutputWidth };
+
+			for (int x{}; x < m_OutputWidth; ++x)
+			{
+				const UpscaleTaps& column{ m_UpscaleColumns[x] };
+				const uint32_t top{ LerpPixel(pFirstRow[column.first], pFirstRow[column.second], column.weight) };
+				const uint32_t bottom{ LerpPixel(pSecondRow[column.first], pSecondRow[column.second], column.weight) };
+
+				pOutputRow[x] = LerpPixel(top, bottom, row.weight);
+			}
+		});
+}
+
+bool Renderer::Render(Scene* pScene)
+{
+	const FrameUpdate frameUpdate{ UpdateFrameState(pScene) };
+	if (frameUpdate == FrameUpdate::None && IsFrameComplete())
+	{
+		m_FrameStatistics = {};
+		return false;
+	}
+
+	m_IsProfilingFrame = Profiler::GetInstance().IsCapturing();
+
+	//Scratch memory of the previous frame is reused
+	ScratchAllocator::BeginFrame();
+
+	//A budgeted frame takes several calls, its tiles must all see the same shadow cache frame
+	//UpdateRenderTiles restarts the tiles for every update, otherwise this call continues the previous frame
+	if (frameUpdate != FrameUpdate::None)
+	{
+		//Cached shadow results are only valid for the geometry and lights they were traced against
+		const uint64_t sceneVersion{ pScene->GetVersion() };
+		if (sceneVersion != m_ShadowCacheSceneVersion)
+		{
+			m_ShadowCache.Invalidate();
+			m_ShadowCacheSceneVersion = sceneVersion;
+		}
+		m_ShadowCache.BeginFrame();
+	}
+
 	Camera& camera = pScene->GetCamera();
 	auto& materials = pScene->GetMaterials();
 	auto& lights = pScene->GetLights();
 
-	const float fieldOfView{ tanf(camera.fovAngle*TO_RADIANS * 0.5f) };
+	//Only rebuilt or rotated when the field of view, resolution or camera rotation changed
+	m_PrimaryRays.Update(m_Width, m_Height, camera.fovAngle, camera.cameraToWorld);
+	pScene->UpdatePrimaryRayContext(camera, m_Width, m_Height, m_PrimaryRayContext);
+	UpdateRenderTiles(pScene, frameUpdate);
+
+	m_DirectionalLights.clear();
+	for (uint32_t lightIndex{}; lightIndex < lights.size(); ++lightIndex)
+	{
+		const Light& light{ lights[lightIndex] };
+		if (light.type != LightType::Directional) continue;
+
+		const Vector3 direction{ LightUtils::GetDirectionToLight(light, Vector3::Zero) };
+		m_DirectionalLights.push_back(DirectionalLightData{ lightIndex, direction, { 1.f / direction.x,1.f / direction.y,1.f / direction.z }, LightUtils::GetRadiance(light, Vector3::Zero) });
+	}
+
+#if defined(ENABLE_PROFILER)
+	const uint64_t renderStartTicks{ Profiler::GetTicks() };
+#endif
+
+	//The tiles from m_NextRenderTile on are left from the previous call or new, with a budget only part of them is done now
+	//Profiling captures need every frame complete, so they ignore the budget
+	const uint32_t firstTile{ m_NextRenderTile };
+	const uint32_t nrRenderTiles{ static_cast<uint32_t>(m_RenderTiles.size()) };
+
+	const bool isBudgeted{ m_FrameBudget > 0.f && !m_IsProfilingFrame };
+	const auto deadline{ std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(m_FrameBudget)) };
+	const auto isTimeLeft{ [=] { return !isBudgeted || std::chrono::steady_clock::now() < deadline; } };
 
 #if defined(ASYNC)
-	//Async logic
+	//Async logic, the tasks have no budget
+	(void)isTimeLeft;
 	const uint32_t numCores = std::thread::hardware_concurrency();
 	std::vector<std::future<void>> async_futures{};
 
-	const uint32_t numPixelsPerTask = numPixels / numCores;
-	uint32_t numUnassignedPixels = numPixels % numCores;
-	uint32_t currentPixelIndex{ 0 };
+	const uint32_t numTiles = nrRenderTiles - firstTile;
+	const uint32_t numTilesPerTask = numTiles / numCores;
+	uint32_t numUnassignedTiles = numTiles % numCores;
+	uint32_t currentTileIndex{ firstTile };
 
 	for (uint32_t coreId{ 0 }; coreId < numCores; ++coreId)
 	{
-		uint32_t taskSize{ numPixelsPerTask };
-		if (numUnassignedPixels > 0)
+		uint32_t taskSize{ numTilesPerTask };
+		if (numUnassignedTiles > 0)
 		{
 			++taskSize;
-			--numUnassignedPixels;
+			--numUnassignedTiles;
 		}
 
 		async_futures.push_back(std::async(std::launch::async, [=, this]
 			{
-				const uint32_t pixelIndexEnd = currentPixelIndex + taskSize;
-				for (uint32_t pixelIndex{ currentPixelIndex }; pixelIndex < pixelIndexEnd; ++pixelIndex)
+				const uint32_t tileIndexEnd = currentTileIndex + taskSize;
+				for (uint32_t tileIndex{ currentTileIndex }; tileIndex < tileIndexEnd; ++tileIndex)
 				{
-					RenderPixel(pScene, pixelIndex, fieldOfView, camera, lights, materials);
+					RenderTile(pScene, m_RenderTiles[tileIndex], camera, lights, materials);
 				}
 				
 			})
 		);
 
-		currentPixelIndex += taskSize;
+		currentTileIndex += taskSize;
 	}
 
 	//Wait for all tasks
@@ -75,51 +324,302 @@ void Renderer::Render(Scene* pScene) const
 	{
 		f.wait();
 	}
+	m_NextRenderTile = nrRenderTiles;
 
 #elif defined(PARALLEL_FOR)
-	//Parallel For logic
-	concurrency::parallel_for(0u, m_NumberOfPixels, [=, this](int i)
+	if (!isBudgeted)
+	{
+		//Parallel For logic, a task per tile so its pixels share their candidate objects
+		concurrency::parallel_for(firstTile, nrRenderTiles, [=, this](uint32_t renderTileIndex)
+		{
+				RenderTile(pScene, m_RenderTiles[renderTileIndex], camera, lights, materials);
+		});
+		m_NextRenderTile = nrRenderTiles;
+	}
+	else
 	{
-			RenderPixel(pScene, i, fieldOfView, camera, lights, materials);
-	});
+		//Every worker takes the next tile until the budget runs out, taken tiles are finished so the ones before nextTile are all done
+		std::atomic<uint32_t> nextTile{ firstTile };
+		const uint32_t nrWorkers{ std::max(std::thread::hardware_concurrency(), 1u) };
+
+		concurrency::parallel_for(0u, nrWorkers, [&](uint32_t)
+		{
+				while (isTimeLeft())
+				{
+					const uint32_t renderTileIndex{ nextTile.fetch_add(1) };
+					if (renderTileIndex >= nrRenderTiles) break;
+
+					RenderTile(pScene, m_RenderTiles[renderTileIndex], camera, lights, materials);
+				}
+		});
+		m_NextRenderTile = std::min(nextTile.load(), nrRenderTiles);
+	}
 
 #else
 	//Synchronous logic
-	for (uint32_t i{ 0 }; i < m_NumberOfPixels; ++i)
+	for (; m_NextRenderTile < nrRenderTiles && isTimeLeft(); ++m_NextRenderTile)
+	{
+		RenderTile(pScene, m_RenderTiles[m_NextRenderTile], camera, lights, materials);
+	}
+#endif
+
+#if defined(ENABLE_PROFILER)
+	Profiler::GetInstance().AddScopedTime(ProfileStage::Render, renderStartTicks, Profiler::GetTicks());
+
+	//The per thread values are never cleared (that frees and reallocates them), the frame values are the difference with the previous totals
+	if (m_IsProfilingFrame)
+	{
+		PixelStageTicks totalTicks{};
+		m_PixelStageTicks.combine_each([&](const PixelStageTicks& threadTicks)
+			{
+				for (int stage{}; stage < 4; ++stage) totalTicks.ticks[stage] += threadTicks.ticks[stage];
+			});
+
+		for (int stage{}; stage < 4; ++stage)
+		{
+			Profiler::GetInstance().AddStageTime(static_cast<ProfileStage>(static_cast<int>(ProfileStage::PrimaryTrace) + stage), (totalTicks.ticks[stage] - m_PixelStageTicksTotal.ticks[stage]) * PROFILED_PIXEL_STRIDE);
+		}
+
+		m_PixelStageTicksTotal = totalTicks;
+	}
+#endif
+
+	const uint64_t shadowRaysTotal{ m_ShadowRayCounts.combine(std::plus<uint64_t>{}) };
+
+	m_FrameStatistics.primaryRays = 0;
+	for (uint32_t renderTileIndex{ firstTile }; renderTileIndex < m_NextRenderTile; ++renderTileIndex)
 	{
-		RenderPixel(pScene, i, fieldOfView, camera, lights, materials);
+		m_FrameStatistics.primaryRays += GetTileSize(m_RenderTiles[renderTileIndex]);
 	}
+	m_FrameStatistics.shadowRays = shadowRaysTotal - m_ShadowRaysTotal;
+	m_ShadowRaysTotal = shadowRaysTotal;
+
+#if defined(RAY_STATISTICS)
+	RayStatistics rayStatisticsTotal{};
+	m_ThreadRayStatistics.combine_each([&rayStatisticsTotal](const RayStatistics& threadStatistics) { rayStatisticsTotal += threadStatistics; });
+
+	m_RayStatistics = rayStatisticsTotal;
+	m_RayStatistics -= m_RayStatisticsTotal;
+	m_RayStatisticsTotal = rayStatisticsTotal;
+
+	if (m_HeatmapEnabled) RenderHeatmap();
 #endif
 
+	if (!m_ScaledPixels.empty()) Upscale();
+
 	//@END
 	//Update SDL Surface
+	if (!m_pWindow) return true;
+
+	PROFILE_SCOPE(ProfileStage::Present);
 	SDL_UpdateWindowSurface(m_pWindow);
+	return true;
 }
 
-void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fieldOfView, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials) const
+//A full frame when the camera, a renderer setting or what is in the scene changed, a partial one when only meshes moved
+Renderer::FrameUpdate Renderer::UpdateFrameState(Scene* pScene)
 {
-	const uint32_t px{ pixelIndex % m_Width }, py{ pixelIndex / m_Width };
+	const Camera& camera{ pScene->GetCamera() };
+	const std::vector<TriangleMesh>& triangleMeshes{ pScene->GetTriangleMeshGeometries() };
+
+	//Profiling captures need every frame
+	const bool isFullFrame{ m_IsFrameDirty
+		|| Profiler::GetInstance().IsCapturing()
+		|| pScene != m_pLastScene
+		|| pScene->GetContentVersion() != m_LastContentVersion
+		|| triangleMeshes.size() != m_LastMeshVersions.size()
+		|| camera.fovAngle != m_LastFovAngle
+		|| memcmp(&camera.cameraToWorld, &m_LastCameraToWorld, sizeof(Matrix)) != 0 };
+
+	m_ChangedBounds.clear();
+	m_LastMeshVersions.resize(triangleMeshes.size());
+	m_LastMeshBounds.resize(triangleMeshes.size());
+
+	for (size_t meshIndex{}; meshIndex < triangleMeshes.size(); ++meshIndex)
+	{
+		const TriangleMesh& triangleMesh{ triangleMeshes[meshIndex] };
+		if (!isFullFrame && triangleMesh.transformVersion == m_LastMeshVersions[meshIndex]) continue;
 
-	Ray viewRay{ camera.origin ,Vector3::Zero };
-	ColorRGB finalColor{ dae::colors::Black };
+		const Aabb bounds{ triangleMesh.GetWorldBounds() };
+		if (!isFullFrame)
+		{
+			//What was behind the old position is uncovered, what is at the new one covered
+			Aabb changedBounds{ m_LastMeshBounds[meshIndex] };
+			changedBounds.grow(bounds.min);
+			changedBounds.grow(bounds.max);
+
+			//Meshes without triangles have empty bounds
+			if (changedBounds.min.x <= changedBounds.max.x) m_ChangedBounds.push_back(changedBounds);
+		}
+
+		m_LastMeshVersions[meshIndex] = triangleMesh.transformVersion;
+		m_LastMeshBounds[meshIndex] = bounds;
+	}
+
+	if (!isFullFrame) return m_ChangedBounds.empty() ? FrameUpdate::None : FrameUpdate::Partial;
+
+	m_IsFrameDirty = false;
+	m_pLastScene = pScene;
+	m_LastContentVersion = pScene->GetContentVersion();
+	m_LastFovAngle = camera.fovAngle;
+	m_LastCameraToWorld = camera.cameraToWorld;
+
+	return FrameUpdate::Full;
+}
+
+//Needs the primary ray context of this frame, it projects the changed bounds
+//Tiles of an unfinished frame stay in the list, they are rendered with the current state when their turn comes
+void Renderer::UpdateRenderTiles(const Scene* pScene, FrameUpdate frameUpdate)
+{
+	const uint32_t nrTilesX{ m_PrimaryRayContext.nrTilesX };
+	const uint32_t nrTiles{ nrTilesX * m_PrimaryRayContext.nrTilesY };
+
+	if (frameUpdate == FrameUpdate::None) return;
+
+	if (frameUpdate == FrameUpdate::Full)
+	{
+		m_TileHitBounds.assign(nrTiles, Aabb{});
+		m_RenderTiles.clear();
+		for (uint32_t tileIndex{}; tileIndex < nrTiles; ++tileIndex) m_RenderTiles.push_back(tileIndex);
+		m_NextRenderTile = 0;
+		return;
+	}
 
-	const float cx{ (((2.f * (px + 0.5f)) / static_cast<float>(m_Width)) - 1) * m_AspectRatio * fieldOfView };
-	const float cy{ (1 - ((2.f * (py + 0.5f)) / static_cast<float>(m_Height))) * fieldOfView };
+	m_IsTileDirty.assign(nrTiles, 0);
+	for (uint32_t renderTileIndex{ m_NextRenderTile }; renderTileIndex < m_RenderTiles.size(); ++renderTileIndex)
+	{
+		m_IsTileDirty[m_RenderTiles[renderTileIndex]] = 1;
+	}
 
-	viewRay.direction = (cx * Vector3::UnitX) + (cy * Vector3::UnitY) + Vector3::UnitZ;
-	viewRay.direction.Normalize();
-	viewRay.direction = camera.cameraToWorld.TransformVector(viewRay.direction);
-	viewRay.inverseDirection = { 1.f / viewRay.direction.x,1.f / viewRay.direction.y,1.f / viewRay.direction.z };
+	const auto markTiles{ [&](const PrimaryRayContext::TileRect& rect)
+	{
+		for (uint32_t y{ rect.minY }; y <= rect.maxY; ++y)
+		{
+			for (uint32_t x{ rect.minX }; x <= rect.maxX; ++x) m_IsTileDirty[y * nrTilesX + x] = 1;
+		}
+	} };
+
+	//Outside the projected bounds of the moved meshes the primary rays hit the same as before
+	for (const Aabb& bounds : m_ChangedBounds)
+	{
+		markTiles(m_PrimaryRayContext.GetTileRect(bounds));
+	}
+
+	//Then only shadows can change, where the hit points of a tile are in the old or new shadow of a moved mesh
+	if (m_ShadowsEnabled)
+	{
+		for (uint32_t tileIndex{}; tileIndex < nrTiles; ++tileIndex)
+		{
+			const Aabb& hitBounds{ m_TileHitBounds[tileIndex] };
+			if (m_IsTileDirty[tileIndex] || hitBounds.min.x > hitBounds.max.x) continue;
+
+			for (const Aabb& bounds : m_ChangedBounds)
+			{
+				for (const Light& light : pScene->GetLights())
+				{
+					if (CanCastShadow(light, bounds, hitBounds)) m_IsTileDirty[tileIndex] = 1;
+				}
+			}
+		}
+	}
+
+	m_RenderTiles.clear();
+	for (uint32_t tileIndex{}; tileIndex < nrTiles; ++tileIndex)
+	{
+		if (m_IsTileDirty[tileIndex]) m_RenderTiles.push_back(tileIndex);
+	}
+	m_NextRenderTile = 0;
+}
+
+uint32_t Renderer::GetTileSize(uint32_t tileIndex) const
+{
+	const uint32_t nrTilesX{ m_PrimaryRayContext.nrTilesX };
+	const uint32_t startX{ (tileIndex % nrTilesX) * PrimaryRayContext::TileSize };
+	const uint32_t startY{ (tileIndex / nrTilesX) * PrimaryRayContext::TileSize };
+
+	return (std::min(startX + PrimaryRayContext::TileSize, static_cast<uint32_t>(m_Width)) - startX)
+		* (std::min(startY + PrimaryRayContext::TileSize, static_cast<uint32_t>(m_Height)) - startY);
+}
+
+void Renderer::RenderTile(Scene* pScene, uint32_t tileIndex, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials)
+{
+	const uint32_t nrTilesX{ m_PrimaryRayContext.nrTilesX };
+	const uint32_t startX{ (tileIndex % nrTilesX) * PrimaryRayContext::TileSize };
+	const uint32_t startY{ (tileIndex / nrTilesX) * PrimaryRayContext::TileSize };
+	const uint32_t endX{ std::min(startX + PrimaryRayContext::TileSize, static_cast<uint32_t>(m_Width)) };
+	const uint32_t endY{ std::min(startY + PrimaryRayContext::TileSize, static_cast<uint32_t>(m_Height)) };
+
+	Aabb hitBounds{};
+	for (uint32_t py{ startY }; py < endY; ++py)
+	{
+		for (uint32_t px{ startX }; px < endX; ++px)
+		{
+			RenderPixel(pScene, py * m_Width + px, camera, lights, materials, hitBounds);
+		}
+	}
+
+	m_TileHitBounds[tileIndex] = hitBounds;
+}
+
+void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials, Aabb& tileHitBounds)
+{
+#if defined(ENABLE_PROFILER)
+	PixelStageTimer stageTimer{ m_IsProfilingFrame && pixelIndex % PROFILED_PIXEL_STRIDE == 0 ? m_PixelStageTicks.local().ticks : nullptr };
+#endif
+
+#if defined(RAY_STATISTICS)
+	RayStatistics& pixelStatistics{ RayStatistics::GetThreadLocal() };
+	pixelStatistics = {};
+#endif
+
+	Ray viewRay{ camera.origin, m_PrimaryRays.GetDirection(pixelIndex), m_PrimaryRays.GetInverseDirection(pixelIndex) };
+	ColorRGB finalColor{ dae::colors::Black };
 
 	HitRecord closestHit{};
-	pScene->GetClosestHit(viewRay, closestHit);
+	const uint32_t tileIndex{ m_PrimaryRayContext.GetTileIndex(pixelIndex % m_Width, pixelIndex / m_Width) };
+	pScene->GetClosestHit(viewRay, m_PrimaryRayContext, tileIndex, closestHit);
+	RAY_STATISTIC_RAY(RayType::Primary, closestHit.didHit);
+	PIXEL_STAGE_END(ProfileStage::PrimaryTrace);
 
 	if (closestHit.didHit)
 	{
+		tileHitBounds.grow(closestHit.origin);
+
 		Ray lightRay{ closestHit.origin + closestHit.normal * 0.0002f };
+		uint32_t shadowRayCount{};
 
-		for (const Light& light : lights)
+		//Directional lights: constant direction and radiance, shadow rays are unbounded
+		for (const DirectionalLightData& directionalLight : m_DirectionalLights)
 		{
+			if (m_ShadowsEnabled)
+			{
+				lightRay.direction = directionalLight.direction;
+				lightRay.inverseDirection = directionalLight.inverseDirection;
+				lightRay.max = FLT_MAX;
+
+				const bool isVisible{ IsLightVisible(pScene, lightRay, closestHit, directionalLight.lightIndex, shadowRayCount) };
+				PIXEL_STAGE_END(ProfileStage::ShadowTrace);
+
+				if (!isVisible) continue;
+			}
+
+			CalculateFinalColor(directionalLight.radiance, 1.f, directionalLight.direction, closestHit, materials, viewRay.direction, finalColor);
+			PIXEL_STAGE_END(ProfileStage::Shading);
+		}
+
+		//Only the lights that can still contribute get a shadow ray
+		ScratchScope scratch{};
+		LightSample* pLightSamples{ scratch.Allocate<LightSample>(m_MaxShadowRaysPerPixel) };
+
+		//Same samples every frame while the lights do not change, a still image does not flicker
+		uint32_t randomState{ (pixelIndex * 9781u + static_cast<uint32_t>(pScene->GetLightVersion()) * 6271u) | 1u };
+		const uint32_t nrLightSamples{ pScene->GetLightTree().SelectLights(lightRay.origin, m_LightCullThreshold, m_MaxShadowRaysPerPixel, randomState, pLightSamples) };
+
+		for (uint32_t sampleIndex{}; sampleIndex < nrLightSamples; ++sampleIndex)
+		{
+			const LightSample& lightSample{ pLightSamples[sampleIndex] };
+			const Light& light{ lights[lightSample.lightIndex] };
+
 			lightRay.direction = LightUtils::GetDirectionToLight(light, lightRay.origin);
 			lightRay.max = lightRay.direction.Normalize();
 			lightRay.inverseDirection = { 1.f / lightRay.direction.x,1.f / lightRay.direction.y,1.f / lightRay.direction.z };
@@ -127,25 +627,94 @@ void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fieldO
 			if (m_ShadowsEnabled) //als de schaduwen aan staan
 			{
 				//en als er niets zit tussen de lichtbron en deze pixel
-				if (!pScene->DoesHit(lightRay))
+				const bool isVisible{ IsLightVisible(pScene, lightRay, closestHit, lightSample.lightIndex, shadowRayCount) };
+				PIXEL_STAGE_END(ProfileStage::ShadowTrace);
+
+				if (isVisible)
 				{
-					CalculateFinalColor(light, lightRay.direction, closestHit, materials, viewRay.direction, finalColor); //dan berekenen we licht
+					CalculateFinalColor(LightUtils::GetRadiance(light, closestHit.origin), lightSample.weight, lightRay.direction, closestHit, materials, viewRay.direction, finalColor); //dan berekenen we licht
 				}
 			}
 			else
 			{
-				CalculateFinalColor(light, lightRay.direction, closestHit, materials, viewRay.direction, finalColor);
+				CalculateFinalColor(LightUtils::GetRadiance(light, closestHit.origin), lightSample.weight, lightRay.direction, closestHit, materials, viewRay.direction, finalColor);
 			}
+			PIXEL_STAGE_END(ProfileStage::Shading);
 		}
+
+		if (shadowRayCount > 0) m_ShadowRayCounts.local() += shadowRayCount;
 	}
 
+#if defined(RAY_STATISTICS)
+	m_ThreadRayStatistics.local() += pixelStatistics;
+
+	//The colors are written once the costs of all pixels are known
+	if (m_HeatmapEnabled)
+	{
+		m_PixelCosts[pixelIndex] = pixelStatistics.GetCost();
+		return;
+	}
+#endif
+
 	//Update Color in Buffer
 	finalColor.MaxToOne();
 
-	m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
+	m_pBufferPixels[pixelIndex] = SDL_MapRGB(m_pBuffer->format,
 		static_cast<uint8_t>(finalColor.r * 255),
 		static_cast<uint8_t>(finalColor.g * 255),
 		static_cast<uint8_t>(finalColor.b * 255));
+	PIXEL_STAGE_END(ProfileStage::FramebufferConversion);
+}
+
+bool Renderer::IsLightVisible(const Scene* pScene, const Ray& lightRay, const HitRecord& closestHit, uint32_t lightIndex, uint32_t& shadowRayCount)
+{
+	if (!m_ShadowCacheEnabled)
+	{
+		++shadowRayCount;
+		const bool isOccluded{ pScene->DoesHit(lightRay) };
+		RAY_STATISTIC_RAY(RayType::Shadow, isOccluded);
+
+		return !isOccluded;
+	}
+
+	const uint64_t key{ m_ShadowCache.GetKey(closestHit.origin, closestHit.normal, lightIndex) };
+
+	bool isVisible{};
+	if (m_ShadowCache.Lookup(key, isVisible)) return isVisible;
+
+	++shadowRayCount;
+	isVisible = !pScene->DoesHit(lightRay);
+	RAY_STATISTIC_RAY(RayType::Shadow, !isVisible);
+	m_ShadowCache.Store(key, isVisible);
+
+	return isVisible;
+}
+
+void Renderer::RenderHeatmap()
+{
+	//Normalized to the most expensive pixel of the frame
+	const uint64_t maxCost{ std::max(*std::max_element(m_PixelCosts.begin(), m_PixelCosts.end()), uint64_t{ 1 }) };
+	const float inverseMaxCost{ 1.f / static_cast<float>(maxCost) };
+
+	concurrency::parallel_for(0u, m_NumberOfPixels, [=, this](uint32_t pixelIndex)
+		{
+			const ColorRGB color{ GetHeatmapColor(static_cast<float>(m_PixelCosts[pixelIndex]) * inverseMaxCost) };
+
+			m_pBufferPixels[pixelIndex] = SDL_MapRGB(m_pBuffer->format,
+				static_cast<uint8_t>(color.r * 255),
+				static_cast<uint8_t>(color.g * 255),
+				static_cast<uint8_t>(color.b * 255));
+		});
+}
+
+void Renderer::ToggleHeatmap()
+{
+#if defined(RAY_STATISTICS)
+	m_HeatmapEnabled = !m_HeatmapEnabled;
+	m_IsFrameDirty = true;
+#else
+	std::cout << "Heatmap needs ray statistics, define RAY_STATISTICS in RayStatistics.h" << std::endl;
+#endif
 }
 
 bool Renderer::SaveBufferToImage() const
@@ -153,8 +722,15 @@ bool Renderer::SaveBufferToImage() const
 	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
 }
 
+const uint32_t* Renderer::GetBufferPixels() const
+{
+	return static_cast<const uint32_t*>(m_pBuffer->pixels);
+}
+
 void dae::Renderer::CycleLightingMode()
 {
+	m_IsFrameDirty = true;
+
 	if (m_CurrentLightingMode != LightingMode::Combined)
 	{
 		m_CurrentLightingMode = static_cast<LightingMode>(static_cast<int>(m_CurrentLightingMode) + 1);
@@ -165,7 +741,7 @@ void dae::Renderer::CycleLightingMode()
 	}
 }
 
-void Renderer::CalculateFinalColor(const Light& light, const Vector3& lightRayDirection, const HitRecord& closestHit, const std::vector<Material*>& materials, const Vector3& viewRayDirection, ColorRGB& finalColor) const
+void Renderer::CalculateFinalColor(const ColorRGB& radiance, float lightWeight, const Vector3& lightRayDirection, const HitRecord& closestHit, const std::vector<Material*>& materials, const Vector3& viewRayDirection, ColorRGB& finalColor) const
 {
 	const float observedArea{ Vector3::Dot(closestHit.normal,lightRayDirection) };
 
@@ -174,22 +750,22 @@ void Renderer::CalculateFinalColor(const Light& light, const Vector3& lightRayDi
 		case LightingMode::ObservedArea:
 			if (observedArea > 0.f)
 			{
-				finalColor += ColorRGB{ 1.f,1.f,1.f } * observedArea;
+				finalColor += ColorRGB{ 1.f,1.f,1.f } * (observedArea * lightWeight);
 			}
 			break;
 
 		case LightingMode::Radiance:
-			finalColor += LightUtils::GetRadiance(light, closestHit.origin);
+			finalColor += radiance * lightWeight;
 			break;
 
 		case LightingMode::BRDF:
-				finalColor += materials[closestHit.materialIndex]->Shade(closestHit, lightRayDirection, viewRayDirection);
+				finalColor += materials[closestHit.materialIndex]->Shade(closestHit, lightRayDirection, viewRayDirection) * lightWeight;
 			break;
 
 		case LightingMode::Combined:
 			if (observedArea > 0.f)
 			{
-				finalColor += LightUtils::GetRadiance(light, closestHit.origin) * materials[closestHit.materialIndex]->Shade(closestHit, lightRayDirection, viewRayDirection) * observedArea;
+				finalColor += radiance * materials[closestHit.materialIndex]->Shade(closestHit, lightRayDirection, viewRayDirection) * (observedArea * lightWeight);
 			}
 			break;
 		}
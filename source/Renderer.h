@@ -3,6 +3,15 @@
 #include <cstdint>
 #include <vector>
 
+#include <ppl.h>
+
+#include "Math.h"
+#include "ShadowCache.h"
+#include "RayStatistics.h"
+#include "Profiler.h"
+#include "PrimaryRayTable.h"
+#include "PrimaryRayContext.h"
+
 struct SDL_Window;
 struct SDL_Surface;
 
@@ -10,6 +19,7 @@ struct SDL_Surface;
 namespace dae
 {
 	struct Light;
+	struct Ray;
 	struct Vector3;
 	struct HitRecord;
 	struct ColorRGB;
@@ -22,30 +32,80 @@ namespace dae
 	{
 	public:
 		Renderer(SDL_Window* pWindow);
-		~Renderer() = default;
+		Renderer(int width, int height); //Offscreen, renders into its own surface and presents nothing
+		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer(Renderer&&) noexcept = delete;
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Scene* pScene) const;
+		//Returns false when nothing changed since the previous frame, which is then still in the buffer
+		//With a frame budget a call renders tiles until the budget is used up and presents the partly updated frame,
+		//the next calls continue it until IsFrameComplete. A camera or settings change restarts the frame.
+		bool Render(Scene* pScene);
+		//Forces the next frame to be rendered
+		void Invalidate() { m_IsFrameDirty = true; }
+
+		//Seconds per Render call, 0 renders every frame completely
+		void SetFrameBudget(float seconds) { m_FrameBudget = seconds; }
+		float GetFrameBudget() const { return m_FrameBudget; }
+		bool IsFrameComplete() const { return m_NextRenderTile >= m_RenderTiles.size(); }
 
 		bool SaveBufferToImage() const;
+		//ARGB8888 at the output size, the offscreen renderer's image for whoever presents it
+		const uint32_t* GetBufferPixels() const;
 		
 		void CycleLightingMode();
-		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; };
+		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; m_IsFrameDirty = true; };
+		void ToggleShadowCache() { m_ShadowCacheEnabled = !m_ShadowCacheEnabled; m_ShadowCache.Invalidate(); m_IsFrameDirty = true; };
+		void ToggleHeatmap();
+
+		void SetShadowsEnabled(bool isEnabled) { m_ShadowsEnabled = isEnabled; m_IsFrameDirty = true; }
+		void SetShadowCacheEnabled(bool isEnabled) { m_ShadowCacheEnabled = isEnabled; m_ShadowCache.Invalidate(); m_IsFrameDirty = true; }
+
+		//Renders scale times the window width and height and upscales the result bilinearly, see DynamicResolution
+		void SetResolutionScale(float scale);
+		float GetResolutionScale() const { return m_ResolutionScale; }
+		int GetRenderWidth() const { return m_Width; }
+		int GetRenderHeight() const { return m_Height; }
+
+		struct FrameStatistics
+		{
+			uint64_t primaryRays{};
+			uint64_t shadowRays{}; //Actually traced, shadow cache hits are not counted
+		};
+		const FrameStatistics& GetFrameStatistics() const { return m_FrameStatistics; }
+		//Only filled when RAY_STATISTICS is defined
+		const RayStatistics& GetRayStatistics() const { return m_RayStatistics; }
 
 	private:
 		SDL_Window* m_pWindow{};
 
 		SDL_Surface* m_pBuffer{};
 		uint32_t* m_pBufferPixels{};
+		bool m_OwnsBuffer{ false };
 
+		//Size of the window or offscreen surface
+		int m_OutputWidth{};
+		int m_OutputHeight{};
+
+		//Render resolution, smaller than the output with a resolution scale below 1
 		int m_Width{};
 		int m_Height{};
 		uint32_t  m_NumberOfPixels{};
-		float m_AspectRatio{};
+
+		//When the render resolution is smaller the pixels are written here and upscaled to the surface
+		float m_ResolutionScale{ 1.f };
+		std::vector<uint32_t> m_ScaledPixels{};
+
+		//Bilinear filter taps of every output column and row, weight of the second sample in 1/256
+		struct UpscaleTaps
+		{
+			uint32_t first, second, weight;
+		};
+		std::vector<UpscaleTaps> m_UpscaleColumns{};
+		std::vector<UpscaleTaps> m_UpscaleRows{};
 
 		enum class LightingMode
 		{
@@ -58,7 +118,89 @@ namespace dae
 		LightingMode m_CurrentLightingMode{ LightingMode::Combined };
 		bool m_ShadowsEnabled{ true };
 
-		void CalculateFinalColor(const Light& light, const Vector3& lightRayDirection, const HitRecord& closestHit, const std::vector<Material*>& materials, const Vector3& viewRayDirection, ColorRGB& finalColor) const;
-		void RenderPixel(Scene* pScene, uint32_t pixelIndex, float fieldOfView, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials) const;
+		//Light selection
+		float m_LightCullThreshold{ 0.001f }; //Lights contributing less radiance than this get no shadow ray
+		uint32_t m_MaxShadowRaysPerPixel{ 8 }; //Above this many point lights they are importance sampled
+
+		//Directional lights are the same for every pixel, prepared once per frame
+		struct DirectionalLightData
+		{
+			uint32_t lightIndex;
+			Vector3 direction; //Towards the light
+			Vector3 inverseDirection;
+			ColorRGB radiance;
+		};
+		std::vector<DirectionalLightData> m_DirectionalLights{};
+
+		//What the last frame was rendered with, frames are only rendered when something changed
+		enum class FrameUpdate
+		{
+			None, //The previous frame is still valid
+			Partial, //Only meshes moved, the tiles they or their shadows cover are rendered
+			Full
+		};
+
+		bool m_IsFrameDirty{ true }; //Renderer settings changed
+		const Scene* m_pLastScene{};
+		uint64_t m_LastContentVersion{};
+		Matrix m_LastCameraToWorld{};
+		float m_LastFovAngle{};
+		std::vector<uint64_t> m_LastMeshVersions{};
+		std::vector<Aabb> m_LastMeshBounds{};
+
+		//Union of the previous and current world bounds of every mesh that moved since the last frame
+		std::vector<Aabb> m_ChangedBounds{};
+		std::vector<Aabb> m_TileHitBounds{}; //World bounds of the primary hit points of every tile, where shadows can change
+		std::vector<uint8_t> m_IsTileDirty{};
+		std::vector<uint32_t> m_RenderTiles{}; //Of the current frame, the ones before m_NextRenderTile are done
+		uint32_t m_NextRenderTile{};
+		float m_FrameBudget{};
+
+		PrimaryRayTable m_PrimaryRays{};
+		PrimaryRayContext m_PrimaryRayContext{};
+
+		//Shadow ray results reused between frames while the scene does not change
+		ShadowCache m_ShadowCache{};
+		bool m_ShadowCacheEnabled{ true };
+		uint64_t m_ShadowCacheSceneVersion{};
+
+		//Profiling, during a capture every PROFILED_PIXEL_STRIDE-th pixel times its stages
+		bool m_IsProfilingFrame{ false };
+#if defined(ENABLE_PROFILER)
+		static constexpr uint32_t PROFILED_PIXEL_STRIDE{ 16 };
+		struct PixelStageTicks
+		{
+			uint64_t ticks[4]{}; //PrimaryTrace, ShadowTrace, Shading, FramebufferConversion
+		};
+		//The combinables only grow, totals of the previous frame are kept to get the values of one frame
+		concurrency::combinable<PixelStageTicks> m_PixelStageTicks{};
+		PixelStageTicks m_PixelStageTicksTotal{};
+#endif
+
+		FrameStatistics m_FrameStatistics{};
+		concurrency::combinable<uint64_t> m_ShadowRayCounts{};
+		uint64_t m_ShadowRaysTotal{};
+
+		//Ray statistics of the last frame, the heatmap shows the traversal cost of every pixel instead of its color
+		RayStatistics m_RayStatistics{};
+		concurrency::combinable<RayStatistics> m_ThreadRayStatistics{};
+		RayStatistics m_RayStatisticsTotal{};
+		bool m_HeatmapEnabled{ false };
+		std::vector<uint64_t> m_PixelCosts{};
+
+		void Initialize();
+		void UpdateRenderBuffer();
+		static void CalculateUpscaleTaps(uint32_t sourceSize, uint32_t targetSize, std::vector<UpscaleTaps>& taps);
+		void Upscale();
+		FrameUpdate UpdateFrameState(Scene* pScene);
+		void UpdateRenderTiles(const Scene* pScene, FrameUpdate frameUpdate);
+		bool IsLightVisible(const Scene* pScene, const Ray& lightRay, const HitRecord& closestHit, uint32_t lightIndex, uint32_t& shadowRayCount);
+
+		void RenderHeatmap();
+
+		void CalculateFinalColor(const ColorRGB& radiance, float lightWeight, const Vector3& lightRayDirection, const HitRecord& closestHit, const std::vector<Material*>& materials, const Vector3& viewRayDirection, ColorRGB& finalColor) const;
+		uint32_t GetTileSize(uint32_t tileIndex) const; //Pixels, tiles at the right and bottom edge can be smaller
+		void RenderTile(Scene* pScene, uint32_t tileIndex, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials);
+		void RenderPixel(Scene* pScene, uint32_t pixelIndex, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials, Aabb& tileHitBounds);
 	};
 }
@@ -1,6 +1,8 @@
 #include "Scene.h"
 #include "Utils.h"
 #include "Material.h"
+#include "MeshCache.h"
+#include "Hash.h"
 
 namespace dae {
 
@@ -48,6 +50,69 @@ namespace dae {
 		{
 			dae::GeometryUtils::HitTest_Plane(plane, ray, closestHit);
 		}
+
+		GeometryUtils::ResolveHit(ray, closestHit);
+	}
+
+	void Scene::GetClosestHit(const Ray& ray, const PrimaryRayContext& context, uint32_t tileIndex, HitRecord& closestHit) const
+	{
+		assert(context.spheres.size() == m_SphereGeometries.size() && context.planeDistances.size() == m_PlaneGeometries.size());
+
+		const PrimaryRayContext::Tile& tile{ context.tiles[tileIndex] };
+
+		for (uint32_t index{ tile.firstSphere }; index < tile.firstSphere + tile.nrSpheres; ++index)
+		{
+			const uint32_t sphereIndex{ context.tileSpheres[index] };
+			const PrimaryRayContext::SphereTerms& terms{ context.spheres[sphereIndex] };
+
+			dae::GeometryUtils::HitTest_Sphere(m_SphereGeometries[sphereIndex], ray, terms.originVector, terms.c, closestHit);
+		}
+
+		for (uint32_t index{ tile.firstMesh }; index < tile.firstMesh + tile.nrMeshes; ++index)
+		{
+			dae::GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[context.tileMeshes[index]], ray, closestHit);
+		}
+
+		for (size_t index{}; index < m_PlaneGeometries.size(); ++index)
+		{
+			dae::GeometryUtils::HitTest_Plane(m_PlaneGeometries[index], ray, context.planeDistances[index], closestHit);
+		}
+
+		GeometryUtils::ResolveHit(ray, closestHit);
+	}
+
+	void Scene::UpdatePrimaryRayContext(const Camera& camera, int width, int height, PrimaryRayContext& context) const
+	{
+		const Vector3& origin{ camera.origin };
+		context.origin = origin;
+
+		context.spheres.resize(m_SphereGeometries.size());
+		context.sphereBounds.resize(m_SphereGeometries.size());
+		for (size_t index{}; index < m_SphereGeometries.size(); ++index)
+		{
+			const Sphere& sphere{ m_SphereGeometries[index] };
+			const Vector3 originVector{ origin - sphere.origin };
+
+			context.spheres[index] = { originVector, Vector3::Dot(originVector, originVector) - sphere.radius * sphere.radius };
+
+			const Vector3 extent{ sphere.radius, sphere.radius, sphere.radius };
+			context.sphereBounds[index] = Aabb{ sphere.origin - extent, sphere.origin + extent };
+		}
+
+		context.planeDistances.resize(m_PlaneGeometries.size());
+		for (size_t index{}; index < m_PlaneGeometries.size(); ++index)
+		{
+			const Plane& plane{ m_PlaneGeometries[index] };
+			context.planeDistances[index] = Vector3::Dot(plane.origin - origin, plane.normal);
+		}
+
+		context.meshBounds.resize(m_TriangleMeshGeometries.size());
+		for (size_t index{}; index < m_TriangleMeshGeometries.size(); ++index)
+		{
+			context.meshBounds[index] = m_TriangleMeshGeometries[index].GetWorldBounds();
+		}
+
+		context.BuildTiles(camera.cameraToWorld, camera.fovAngle, width, height);
 	}
 
 	bool Scene::DoesHit(const Ray& ray) const
@@ -76,6 +141,116 @@ namespace dae {
 		return false;
 	}
 
+	void Scene::SetPipelined(bool isPipelined)
+	{
+		m_IsPipelined = isPipelined;
+
+		for (TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		{
+			triangleMesh.isDoubleBuffered = isPipelined;
+			triangleMesh.SwapTransforms();
+		}
+
+		m_TrianglesBoundingBox = CalculateTrianglesBoundingBox();
+	}
+
+	void Scene::SwapDynamicState()
+	{
+		if (!m_IsPipelined) return;
+
+		for (TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		{
+			triangleMesh.SwapTransforms();
+		}
+
+		m_TrianglesBoundingBox = CalculateTrianglesBoundingBox();
+
+		//Without input the camera only needs its matrix, the position comes from whoever drives it
+		{
+			PROFILE_SCOPE(ProfileStage::CameraUpdate);
+			m_Camera.cameraToWorld = m_Camera.CalculateCameraToWorld();
+		}
+
+		UpdateLights();
+	}
+
+	void Scene::UpdateLights()
+	{
+		const uint64_t lightsHash{ HashBytes(m_Lights.data(), m_Lights.size() * sizeof(Light)) };
+		if (lightsHash != m_LightsHash)
+		{
+			m_LightsHash = lightsHash;
+			++m_LightVersion;
+			m_LightTreeDirty = true;
+		}
+
+		if (m_LightTreeDirty)
+		{
+			m_LightTree.Build(m_Lights);
+			m_LightTreeDirty = false;
+		}
+	}
+
+	void Scene::UpdateTrianglesBoundingBox()
+	{
+		//Pipelined, the meshes only have their new bounds after SwapDynamicState
+		if (m_IsPipelined) return;
+
+		m_TrianglesBoundingBox = CalculateTrianglesBoundingBox();
+	}
+
+	Aabb Scene::CalculateTrianglesBoundingBox() const
+	{
+		Aabb trianglesBoundingBox{};
+
+		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		{
+			const Aabb bounds{ triangleMesh.GetWorldBounds() };
+
+			trianglesBoundingBox.grow(bounds.min);
+			trianglesBoundingBox.grow(bounds.max);
+		}
+
+		return trianglesBoundingBox;
+	}
+
+	uint64_t Scene::GetVersion() const
+	{
+		//Includes the light version, the shadow cache is invalidated when a light moves or changes
+		uint64_t version{ GetContentVersion() };
+
+		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		{
+			version += triangleMesh.transformVersion;
+		}
+
+		return version;
+	}
+
+	float Scene::GetBVHBuildTime() const
+	{
+		float buildTime{};
+
+		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		{
+			buildTime += triangleMesh.bvhBuildTime;
+		}
+
+		return buildTime;
+	}
+
+	float Scene::GetMaxLUTError() const
+	{
+		float maxError{};
+
+		for (const Material* pMaterial : m_Materials)
+		{
+			maxError = std::max(maxError, pMaterial->GetLUTError());
+		}
+
+		return maxError;
+	}
+
 #pragma region Scene Helpers
 
 	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
@@ -86,6 +261,7 @@ namespace dae {
 		s.materialIndex = materialIndex;
 
 		m_SphereGeometries.emplace_back(s);
+		++m_Version;
 		return &m_SphereGeometries.back();
 	}
 
@@ -97,17 +273,18 @@ namespace dae {
 		p.materialIndex = materialIndex;
 
 		m_PlaneGeometries.emplace_back(p);
+		++m_Version;
 		return &m_PlaneGeometries.back();
 	}
 
 	TriangleMesh* Scene::AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex)
 	{
-		TriangleMesh m{};
+		TriangleMesh& m{ m_TriangleMeshGeometries.emplace_back(&m_Arena) };
 		m.cullMode = cullMode;
 		m.materialIndex = materialIndex;
 
-		m_TriangleMeshGeometries.emplace_back(m);
-		return &m_TriangleMeshGeometries.back();
+		++m_Version;
+		return &m;
 	}
 
 	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
@@ -119,18 +296,22 @@ namespace dae {
 		l.type = LightType::Point;
 
 		m_Lights.emplace_back(l);
+		m_LightTreeDirty = true;
+		++m_Version;
 		return &m_Lights.back();
 	}
 
 	Light* Scene::AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color)
 	{
 		Light l;
-		l.direction = direction;
+		l.direction = direction.Normalized();
 		l.intensity = intensity;
 		l.color = color;
 		l.type = LightType::Directional;
 
 		m_Lights.emplace_back(l);
+		m_LightTreeDirty = true;
+		++m_Version;
 		return &m_Lights.back();
 	}
 
@@ -210,10 +391,10 @@ namespace dae {
 		const auto matLambert_Yellow = AddMaterial(new Material_Lambert{ colors::Yellow, 1.f });
 
 		//Phong Material
-		const auto matLambertPhong_Blue = AddMaterial(new Material_LambertPhong(colors::Blue, 1.f, 1.f, 60.f));
+		const auto matLambertPhong_Blue = AddMaterial(new Material_LambertPhong(colors::Blue, 1.f, 1.f, 60.f, m_MaxLUTError));
 
 		//CookTorrence
-		const auto matCookTorrence_Red = AddMaterial(new Material_CookTorrence(colors::Red, 0.f, 0.5f));
+		const auto matCookTorrence_Red = AddMaterial(new Material_CookTorrence(colors::Red, 0.f, 0.5f, m_MaxLUTError));
 
 		//Spheres
 		AddSphere({ -.75f, 1.f, .0f }, 1.f, matCookTorrence_Red);
@@ -290,13 +471,11 @@ namespace dae {
 		AddPlane(Vector3{ -5.f,0.f,0.f }, Vector3{ 1.f,0.f,0.f }, matLambert_GrayBlue); //LEFT
 
 		pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		Utils::ParseOBJ("Resources/simple_cube.obj", pMesh->positions, pMesh->normals, pMesh->indices);
 
 		pMesh->Scale({ 0.7f,0.7f,0.7f });
 		pMesh->Translate({ 0.f,1.f,0.f });
-		pMesh->UpdateTransforms();
 
-		pMesh->InitBVH();
+		MeshCache::LoadOrBuild("Resources/simple_cube.obj", *pMesh);
 
 		//Light
 		AddPointLight(Vector3{ 0.f,5.f,5.f }, 50.f, ColorRGB{ 1.f,0.61f,0.45f }); //Back light
@@ -310,6 +489,8 @@ namespace dae {
 
 		pMesh->RotateY(PI_DIV_2 * pTimer->GetTotal());
 		pMesh->UpdateTransforms();
+
+		UpdateTrianglesBoundingBox();
 	}
 
 	void Scene_W4_ReferenceScene::Initialize()
@@ -346,26 +527,40 @@ namespace dae {
 		//TriangleMesh
 		const Triangle baseTriangle = { Vector3(-0.75f, 1.5f, 0.0f), Vector3(0.75f, 0.0f, 0.0f), Vector3(-0.75f, 0.0f, 0.0f) };
 
+		//Generated into the mesh's own buffers and handed over in one go
+		const auto appendBaseTriangle{ [&baseTriangle](TriangleMesh* pMesh)
+		{
+			Buffer<Vector3> positions{ pMesh->CreateBuffer<Vector3>() };
+			Buffer<int> indices{ pMesh->CreateBuffer<int>() };
+			Buffer<Vector3> normals{ pMesh->CreateBuffer<Vector3>() };
+
+			positions.reserve(3);
+			positions.push_back(baseTriangle.v0);
+			positions.push_back(baseTriangle.v1);
+			positions.push_back(baseTriangle.v2);
+
+			indices.reserve(3);
+			for (int index{}; index < 3; ++index) indices.push_back(index);
+
+			normals.push_back(baseTriangle.normal);
+
+			pMesh->AppendGeometry(std::move(positions), std::move(indices), std::move(normals));
+		} };
+
 		m_pMeshes[0] = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		m_pMeshes[0]->AppendTriangle(baseTriangle, true);
+		appendBaseTriangle(m_pMeshes[0]);
 		m_pMeshes[0]->Translate({ -1.75f, 4.5f, 0.0f });
-		m_pMeshes[0]->UpdateTransforms();
-
-		m_pMeshes[0]->InitBVH();
+		m_pMeshes[0]->CommitGeometry();
 
 		m_pMeshes[1] = AddTriangleMesh(TriangleCullMode::FrontFaceCulling, matLambert_White);
-		m_pMeshes[1]->AppendTriangle(baseTriangle, true);
+		appendBaseTriangle(m_pMeshes[1]);
 		m_pMeshes[1]->Translate({ 0.0f, 4.5f, 0.0f });
-		m_pMeshes[1]->UpdateTransforms();
-
-		m_pMeshes[1]->InitBVH();
+		m_pMeshes[1]->CommitGeometry();
 
 		m_pMeshes[2] = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
-		m_pMeshes[2]->AppendTriangle(baseTriangle, true);
+		appendBaseTriangle(m_pMeshes[2]);
 		m_pMeshes[2]->Translate({ 1.75f, 4.5f, 0.0f });
-		m_pMeshes[2]->UpdateTransforms();
-
-		m_pMeshes[2]->InitBVH();
+		m_pMeshes[2]->CommitGeometry();
 
 		//Lights
 		AddPointLight(Vector3{ 0.f, 5.f, 5.f }, 50.f, ColorRGB{ 1.f, .61f, .45f }); //Back Light
@@ -379,18 +574,13 @@ namespace dae {
 
 		const float yawAngle{ (cos(pTimer->GetTotal()) + 1.f) / 2.f * PI_2 };
 
-		m_TrianglesBoundingBox.min = Vector3{ INFINITY,INFINITY,INFINITY };
-		m_TrianglesBoundingBox.max = -m_TrianglesBoundingBox.min;
-
 		for (const auto pMesh : m_pMeshes)
 		{
 			pMesh->RotateY(yawAngle);
 			pMesh->UpdateTransforms();
-			BVHNode& node = pMesh->bvhNodes[pMesh->rootNodeIndex];
-
-			m_TrianglesBoundingBox.grow(node.minAABB);
-			m_TrianglesBoundingBox.grow(node.maxAABB);
 		}
+
+		UpdateTrianglesBoundingBox();
 	}
 
 	void Scene_W4_BunnyScene::Initialize()
@@ -411,12 +601,12 @@ namespace dae {
 
 		//Bunny Mesh
 		m_pMesh = AddTriangleMesh(dae::TriangleCullMode::BackFaceCulling, matLambert_White);
-		Utils::ParseOBJ("Resources/lowpoly_bunny2.obj", m_pMesh->positions, m_pMesh->normals, m_pMesh->indices);
 
 		m_pMesh->Scale({ 2.f,2.f,2.f });
 
-		m_pMesh->UpdateTransforms();
-		m_pMesh->InitBVH();
+		MeshCache::LoadOrBuild("Resources/lowpoly_bunny2.obj", *m_pMesh);
+		m_pMesh->CalculateVertexNormals();
+		m_pMesh->Compress(); //Rotated every frame, a compressed mesh needs no refit for that
 
 		//Lights
 		AddPointLight(Vector3{ 0.f, 5.f, 5.f }, 50.f, ColorRGB{ 1.f, .61f, .45f }); //Back Light
@@ -431,10 +621,7 @@ namespace dae {
 		m_pMesh->RotateY((cos(pTimer->GetTotal()) + 1.f) / 2.f * PI_2);
 		m_pMesh->UpdateTransforms();
 
-		BVHNode& node = m_pMesh->bvhNodes[m_pMesh->rootNodeIndex];
-		m_TrianglesBoundingBox.grow(node.minAABB);
-		m_TrianglesBoundingBox.grow(node.maxAABB);
-
+		UpdateTrianglesBoundingBox();
 	}
 
 	void Scene_W4_CarScene::Initialize()
@@ -455,12 +642,10 @@ namespace dae {
 
 		//Bunny Mesh
 		m_pMesh = AddTriangleMesh(dae::TriangleCullMode::BackFaceCulling, matLambert_White);
-		Utils::ParseOBJ("Resources/car.obj", m_pMesh->positions, m_pMesh->normals, m_pMesh->indices);
 
 		//m_pMesh->Scale({ 2.f,2.f,2.f });
 
-		m_pMesh->UpdateTransforms();
-		m_pMesh->InitBVH();
+		MeshCache::LoadOrBuild("Resources/car.obj", *m_pMesh, MeshCache::GeometryStorage::Mapped);
 
 		//Lights
 		AddPointLight(Vector3{ 0.f, 5.f, 5.f }, 50.f, ColorRGB{ 1.f, .61f, .45f }); //Back Light
@@ -472,13 +657,11 @@ namespace dae {
 	{
 		Scene::Update(pTimer);
 
+		//Also return true from IsAnimated when enabling this
 		//m_pMesh->RotateY((cos(pTimer->GetTotal()) + 1.f) / 2.f * PI_2);
 		//m_pMesh->UpdateTransforms();
 
-		BVHNode& node = m_pMesh->bvhNodes[m_pMesh->rootNodeIndex];
-		m_TrianglesBoundingBox.grow(node.minAABB);
-		m_TrianglesBoundingBox.grow(node.maxAABB);
-
+		UpdateTrianglesBoundingBox();
 	}
 #pragma endregion
 }
@@ -5,6 +5,10 @@
 #include "Math.h"
 #include "DataTypes.h"
 #include "Camera.h"
+#include "LightTree.h"
+#include "Profiler.h"
+#include "Arena.h"
+#include "PrimaryRayContext.h"
 
 namespace dae
 {
@@ -30,29 +34,75 @@ namespace dae
 		virtual void Initialize() = 0;
 		virtual void Update(dae::Timer* pTimer)
 		{
-			m_Camera.Update(pTimer);
+			//Pipelined, the camera and light tree belong to the frame being rendered, they are updated by SwapDynamicState
+			if (m_IsPipelined) return;
+
+			{
+				PROFILE_SCOPE(ProfileStage::CameraUpdate);
+				m_Camera.Update(pTimer);
+			}
+
+			UpdateLights();
 		}
+		//Scenes that move things over time in Update, the others only change through the camera or renderer settings
+		//Pipelined, Update is then only run for animated scenes
+		virtual bool IsAnimated() const { return false; }
+
+		/**
+		 * \brief Pipelined, Update computes the mesh transforms and BVH refits of the next frame while the current one is being rendered,
+		 * only reading the camera and writing the back buffers of the meshes. SwapDynamicState makes that state current, between frames.
+		 */
+		void SetPipelined(bool isPipelined);
+		bool IsPipelined() const { return m_IsPipelined; }
+		//Between frames, when no Update is running
+		void SwapDynamicState();
 
 		Camera& GetCamera() { return m_Camera; }
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
+		//For primary rays of the pixels in tile tileIndex, see UpdatePrimaryRayContext
+		void GetClosestHit(const Ray& ray, const PrimaryRayContext& context, uint32_t tileIndex, HitRecord& closestHit) const;
+		void UpdatePrimaryRayContext(const Camera& camera, int width, int height, PrimaryRayContext& context) const;
 		bool DoesHit(const Ray& ray) const;
 
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
+		const std::vector<TriangleMesh>& GetTriangleMeshGeometries() const { return m_TriangleMeshGeometries; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
-		const std::vector<Material*> GetMaterials() const { return m_Materials; }
+		const LightTree& GetLightTree() const { return m_LightTree; }
+
+		//Changes whenever geometry or lights are added, a light changes or a mesh is transformed
+		uint64_t GetVersion() const;
+		//Only changes when geometry or lights are added or a light changed, mesh transforms are tracked per mesh by transformVersion
+		uint64_t GetContentVersion() const { return m_Version + m_LightVersion; }
+		//Changes when a light was changed through the pointer AddPointLight or AddDirectionalLight returned, checked once per Update
+		uint64_t GetLightVersion() const { return m_LightVersion; }
+		//Seconds, summed over all meshes
+		float GetBVHBuildTime() const;
+		//Largest error of the materials' lookup tables, 0 when every material uses exact math
+		float GetMaxLUTError() const;
+		const std::vector<Material*>& GetMaterials() const { return m_Materials; }
 
 	protected:
 		std::string	sceneName;
 
+		//Geometry that never changes once built (compressed meshes) is allocated here, declared first so it outlives the meshes
+		Arena m_Arena{};
+
 		std::vector<Plane> m_PlaneGeometries{};
 		std::vector<Sphere> m_SphereGeometries{};
 		std::vector<TriangleMesh> m_TriangleMeshGeometries{};
 		std::vector<Light> m_Lights{};
+		LightTree m_LightTree{};
+		bool m_LightTreeDirty{ false };
+		uint64_t m_LightVersion{};
+		uint64_t m_LightsHash{};
+
+		uint64_t m_Version{};
 		std::vector<Material*> m_Materials{};
 
 		Aabb m_TrianglesBoundingBox{};
 		Aabb m_SpheresBoundingBox{};
+		bool m_IsPipelined{ false };
 
 		Camera m_Camera{};
 
@@ -63,6 +113,14 @@ namespace dae
 		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
 		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
 		unsigned char AddMaterial(Material* pMaterial);
+
+		//Fits m_TrianglesBoundingBox to the current world bounds of the meshes, call after updating their transforms
+		void UpdateTrianglesBoundingBox();
+
+	private:
+		Aabb CalculateTrianglesBoundingBox() const;
+		//Lights can be changed through the pointers handed out, so they are compared with the last frame by hash
+		void UpdateLights();
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -100,7 +158,8 @@ namespace dae
 	class Scene_W3_TestScene final : public Scene
 	{
 	public:
-		Scene_W3_TestScene() = default;
+		//maxLUTError: allowed error of the specular power tables, 0 keeps the exact math (see Scene::GetMaxLUTError)
+		explicit Scene_W3_TestScene(float maxLUTError = 0.f) : m_MaxLUTError{ maxLUTError } {}
 		~Scene_W3_TestScene() override = default;
 
 		Scene_W3_TestScene(const Scene_W3_TestScene&) = delete;
@@ -109,6 +168,9 @@ namespace dae
 		Scene_W3_TestScene& operator=(Scene_W3_TestScene&&) noexcept = delete;
 
 		void Initialize() override;
+
+	private:
+		float m_MaxLUTError;
 	};
 
 	class Scene_W3 final : public Scene
@@ -138,6 +200,7 @@ namespace dae
 
 		void Initialize() override;
 		void Update(Timer* pTimer) override;
+		bool IsAnimated() const override { return true; }
 
 	private:
 		TriangleMesh* pMesh{ nullptr };
@@ -156,6 +219,7 @@ namespace dae
 
 		void Initialize() override;
 		void Update(Timer* pTimer) override;
+		bool IsAnimated() const override { return true; }
 
 	private:
 		TriangleMesh* m_pMeshes[3]{nullptr};
@@ -174,6 +238,7 @@ namespace dae
 
 		void Initialize() override;
 		void Update(Timer* pTimer) override;
+		bool IsAnimated() const override { return true; }
 
 	private:
 		TriangleMesh* m_pMesh{ nullptr };
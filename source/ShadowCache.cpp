@@ -0,0 +1,90 @@
+#include "ShadowCache.h"
+
+using namespace dae;
+
+namespace
+{
+	//splitmix64 finalizer
+	uint64_t Mix(uint64_t value)
+	{
+		value ^= value >> 30;
+		value *= 0xbf58476d1ce4e5b9ull;
+		value ^= value >> 27;
+		value *= 0x94d049bb133111ebull;
+		value ^= value >> 31;
+
+		return value;
+	}
+}
+
+ShadowCache::ShadowCache(uint32_t sizeLog2) :
+	m_pEntries{ std::make_unique<std::atomic<uint64_t>[]>(size_t{ 1 } << sizeLog2) },
+	m_IndexMask{ (uint64_t{ 1 } << sizeLog2) - 1 }
+{
+	for (uint64_t index{}; index <= m_IndexMask; ++index)
+	{
+		m_pEntries[index].store(0, std::memory_order_relaxed);
+	}
+}
+
+void ShadowCache::Invalidate()
+{
+	m_Epoch = (m_Epoch + 1) & EpochMask;
+
+	//Epoch wrapped around, old entries could match again
+	if (m_Epoch == 0)
+	{
+		for (uint64_t index{}; index <= m_IndexMask; ++index)
+		{
+			m_pEntries[index].store(0, std::memory_order_relaxed);
+		}
+
+		m_Epoch = 1;
+	}
+}
+
+void ShadowCache::BeginFrame()
+{
+	m_Frame = (m_Frame + 1) & StampMask;
+}
+
+uint64_t ShadowCache::GetKey(const Vector3& position, const Vector3& normal, uint32_t lightIndex) const
+{
+	const int64_t x{ static_cast<int64_t>(floorf(position.x * m_InverseCellSize)) };
+	const int64_t y{ static_cast<int64_t>(floorf(position.y * m_InverseCellSize)) };
+	const int64_t z{ static_cast<int64_t>(floorf(position.z * m_InverseCellSize)) };
+
+	//Surfaces meeting in one cell (corners) must not share a result, so the normal octant is part of the key
+	const uint64_t octant{ (normal.x < 0.f ? 1u : 0u) | (normal.y < 0.f ? 2u : 0u) | (normal.z < 0.f ? 4u : 0u) };
+
+	uint64_t key{ Mix(static_cast<uint64_t>(x)) };
+	key = Mix(key ^ static_cast<uint64_t>(y));
+	key = Mix(key ^ static_cast<uint64_t>(z));
+	key = Mix(key ^ ((static_cast<uint64_t>(lightIndex) << 3) | octant));
+
+	return key;
+}
+
+bool ShadowCache::Lookup(uint64_t key, bool& isVisible) const
+{
+	const uint64_t entry{ m_pEntries[key & m_IndexMask].load(std::memory_order_relaxed) };
+
+	if ((entry >> 28) != (key >> 28)) return false;
+	if (((entry >> 20) & EpochMask) != m_Epoch) return false;
+
+	const uint64_t age{ (m_Frame - ((entry >> 1) & StampMask)) & StampMask };
+	if (age >= m_MaxAge) return false;
+
+	//Spread the revalidation of the cache over the frames
+	if ((key + m_Frame) % m_RevalidatePeriod == 0) return false;
+
+	isVisible = (entry & 1) != 0;
+	return true;
+}
+
+void ShadowCache::Store(uint64_t key, bool isVisible)
+{
+	const uint64_t entry{ ((key >> 28) << 28) | (m_Epoch << 20) | (m_Frame << 1) | (isVisible ? 1u : 0u) };
+
+	m_pEntries[key & m_IndexMask].store(entry, std::memory_order_relaxed);
+}
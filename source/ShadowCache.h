@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "Math.h"
+
+namespace dae
+{
+	//Caches shadow ray results between frames, keyed on a world space cell of the hit point and a light
+	//Because the key is in world space the results stay valid while the camera moves, as long as the scene does not change.
+	//Every entry is a single atomic word so pixels can read and write it from any thread:
+	// [63..28] tag | [27..20] epoch | [19..1] frame stamp | [0] visible
+	class ShadowCache final
+	{
+	public:
+		explicit ShadowCache(uint32_t sizeLog2 = 20);
+		~ShadowCache() = default;
+
+		ShadowCache(const ShadowCache&) = delete;
+		ShadowCache(ShadowCache&&) noexcept = delete;
+		ShadowCache& operator=(const ShadowCache&) = delete;
+		ShadowCache& operator=(ShadowCache&&) noexcept = delete;
+
+		//Drops every result, call when geometry or lights changed
+		void Invalidate();
+		void BeginFrame();
+
+		uint64_t GetKey(const Vector3& position, const Vector3& normal, uint32_t lightIndex) const;
+
+		//Returns false when the result is missing, too old or picked for revalidation this frame
+		bool Lookup(uint64_t key, bool& isVisible) const;
+		void Store(uint64_t key, bool isVisible);
+
+		void SetCellSize(float cellSize) { m_InverseCellSize = 1.f / cellSize; Invalidate(); }
+
+	private:
+		static constexpr uint64_t StampMask{ (1ull << 19) - 1 };
+		static constexpr uint64_t EpochMask{ (1ull << 8) - 1 };
+
+		std::unique_ptr<std::atomic<uint64_t>[]> m_pEntries{};
+		uint64_t m_IndexMask{};
+
+		float m_InverseCellSize{ 1.f / 0.01f };
+		uint32_t m_MaxAge{ 64 }; //Frames before a result is always traced again
+		uint32_t m_RevalidatePeriod{ 16 }; //Every frame 1 in this many cached results gets traced again
+
+		uint64_t m_Epoch{ 1 };
+		uint64_t m_Frame{};
+	};
+}
@@ -131,6 +131,12 @@ void Timer::Update()
 	}
 }
 
+void Timer::Step(float elapsedSeconds)
+{
+	m_ElapsedTime = elapsedSeconds;
+	m_TotalTime += elapsedSeconds;
+}
+
 void Timer::Stop()
 {
 	if (!m_IsStopped)
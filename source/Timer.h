@@ -24,6 +24,9 @@ namespace dae
 		void Update();
 		void Stop();
 
+		//Advances by a fixed amount instead of the measured time, for deterministic runs
+		void Step(float elapsedSeconds);
+
 		uint32_t GetFPS() const { return m_FPS; };
 		float GetdFPS() const { return m_dFPS; };
 		float GetElapsed() const { return m_ElapsedTime; };
@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace dae
+{
+	//Hands the latest value from one writer thread to one reader thread without locks or waiting
+	//The writer fills its own slot and publishes it by swapping it with the middle slot, the reader swaps the middle slot
+	//with its own when something new was published. Neither ever sees a slot the other is using, values that are
+	//published before the reader looks are skipped, so the reader always gets the newest one.
+	template<typename T>
+	class TripleBuffer final
+	{
+	public:
+		TripleBuffer() = default;
+		~TripleBuffer() = default;
+
+		TripleBuffer(const TripleBuffer&) = delete;
+		TripleBuffer(TripleBuffer&&) noexcept = delete;
+		TripleBuffer& operator=(const TripleBuffer&) = delete;
+		TripleBuffer& operator=(TripleBuffer&&) noexcept = delete;
+
+		//Writer thread, the slot keeps what was last written to it two publishes ago
+		T& GetWriteBuffer() { return m_Slots[m_WriteIndex]; }
+		void Publish()
+		{
+			m_WriteIndex = m_MiddleState.exchange(m_WriteIndex | NewBit, std::memory_order_acq_rel) & IndexMask;
+		}
+
+		//Reader thread, returns false when nothing was published since the last acquire, the read buffer is then unchanged
+		bool Acquire()
+		{
+			if ((m_MiddleState.load(std::memory_order_relaxed) & NewBit) == 0) return false;
+
+			m_ReadIndex = m_MiddleState.exchange(m_ReadIndex, std::memory_order_acq_rel) & IndexMask;
+			return true;
+		}
+		T& GetReadBuffer() { return m_Slots[m_ReadIndex]; }
+
+	private:
+		static constexpr uint8_t IndexMask{ 0x3 };
+		static constexpr uint8_t NewBit{ 0x4 }; //The middle slot was published and not acquired yet
+
+		T m_Slots[3]{};
+		uint8_t m_WriteIndex{ 0 };
+		std::atomic<uint8_t> m_MiddleState{ 1 };
+		uint8_t m_ReadIndex{ 2 };
+	};
+}
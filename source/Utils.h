@@ -1,8 +1,9 @@
 #pragma once
 #include <cassert>
-#include <fstream>
 #include "Math.h"
 #include "DataTypes.h"
+#include "ObjLoader.h"
+#include "RayStatistics.h"
 
 //https://jacco.ompf2.com/2022/04/13/how-to-build-a-bvh-part-1-basics/ --- BVH and boundingbox
 //https://en.wikipedia.org/wiki/M%C3%B6ller%E2%80%93Trumbore_intersection_algorithm --- triangle hit
@@ -31,20 +32,21 @@ namespace dae
 			tmin = std::max(tmin, std::min(tz1, tz2));
 			tmax = std::min(tmax, std::max(tz1, tz2));
 
-			return 0 < tmax && tmax >= tmin;
+			return 0 < tmax && tmax >= tmin && tmin < ray.max;
 		}
 
 #pragma region Sphere HitTest
 
 		//SPHERE HIT-TESTS
-		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		//originVector and c only depend on the ray origin, for primary rays they come from the PrimaryRayContext
+		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, const Vector3& originVector, float c, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
-			const Vector3 originVector{ ray.origin - sphere.origin };
+			RAY_STATISTIC(sphereTests);
 
 			const float a{ Vector3::Dot(ray.direction, ray.direction) };
 			const float b{ 2.f * Vector3::Dot(ray.direction, originVector) };
 
-			const float discriminant{ b * b - 4.f * a * ((Vector3::Dot(originVector,originVector)) - (sphere.radius * sphere.radius)) };
+			const float discriminant{ b * b - 4.f * a * c };
 
 			if (discriminant < 0.f)
 			{
@@ -66,12 +68,9 @@ namespace dae
 				if (calculatedT < hitRecord.t)
 				{
 					hitRecord.t = calculatedT;
-
-					hitRecord.materialIndex = sphere.materialIndex;
 					hitRecord.didHit = true;
-					hitRecord.origin = ray.origin + ray.direction * hitRecord.t;
-					hitRecord.normal = hitRecord.origin - sphere.origin;
-					hitRecord.normal.Normalize();
+					hitRecord.type = HitType::Sphere;
+					hitRecord.pSphere = &sphere;
 				}
 
 				return true;
@@ -80,6 +79,14 @@ namespace dae
 			return false;
 		}
 
+		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			const Vector3 originVector{ ray.origin - sphere.origin };
+			const float c{ Vector3::Dot(originVector, originVector) - sphere.radius * sphere.radius };
+
+			return HitTest_Sphere(sphere, ray, originVector, c, hitRecord, ignoreHitRecord);
+		}
+
 		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray)
 		{
 			HitRecord temp{};
@@ -89,9 +96,10 @@ namespace dae
 #pragma endregion
 #pragma region Plane HitTest
 		//PLANE HIT-TESTS
-		inline bool HitTest_Plane(const Plane& plane, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		//originDistance (signed distance from the ray origin to the plane along its normal) only depends on the ray origin
+		inline bool HitTest_Plane(const Plane& plane, const Ray& ray, float originDistance, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
-			const float calculatedT{ Vector3::Dot(plane.origin - ray.origin, plane.normal) / Vector3::Dot(ray.direction,plane.normal) };
+			const float calculatedT{ originDistance / Vector3::Dot(ray.direction,plane.normal) };
 
 			if (calculatedT >= ray.min && calculatedT <= ray.max)
 			{
@@ -100,11 +108,9 @@ namespace dae
 				if (calculatedT < hitRecord.t)
 				{
 					hitRecord.t = calculatedT;
-
-					hitRecord.materialIndex = plane.materialIndex;
 					hitRecord.didHit = true;
-					hitRecord.origin = ray.origin + ray.direction * hitRecord.t;
-					hitRecord.normal = plane.normal;
+					hitRecord.type = HitType::Plane;
+					hitRecord.pPlane = &plane;
 				}
 
 				return true;
@@ -113,6 +119,11 @@ namespace dae
 			return false;
 		}
 
+		inline bool HitTest_Plane(const Plane& plane, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			return HitTest_Plane(plane, ray, Vector3::Dot(plane.origin - ray.origin, plane.normal), hitRecord, ignoreHitRecord);
+		}
+
 		inline bool HitTest_Plane(const Plane& plane, const Ray& ray)
 		{
 			HitRecord temp{};
@@ -124,6 +135,8 @@ namespace dae
 		//TRIANGLE HIT-TESTS
 		inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
+			RAY_STATISTIC(triangleTests);
+
 			const Vector3 edge1{ triangle.v1 - triangle.v0 };
 			const Vector3 edge2{ triangle.v2 - triangle.v0 };
 
@@ -168,14 +181,14 @@ namespace dae
 			{
 				if (ignoreHitRecord) return true;
 
+				//The mesh that is traversed fills in pMesh and primitiveIndex
 				if (calculatedT < hitRecord.t)
 				{
 					hitRecord.t = calculatedT;
-
-					hitRecord.materialIndex = triangle.materialIndex;
 					hitRecord.didHit = true;
-					hitRecord.origin = ray.origin + ray.direction * hitRecord.t;
-					hitRecord.normal = triangle.normal;
+					hitRecord.type = HitType::Triangle;
+					hitRecord.u = firstCalculation;
+					hitRecord.v = secondCalculation;
 				}
 
 				return true;
@@ -192,144 +205,200 @@ namespace dae
 #pragma endregion
 #pragma region TriangeMesh HitTest
 
-		inline void IntersectBVH(const Ray& ray,const TriangleMesh& mesh, const uint32_t nodeIndex, std::vector<int>& indices)
+		//Both children are pushed, so the stack holds at most one node per level plus the one being expanded
+		constexpr uint32_t BVH_STACK_SIZE{ TriangleMesh::MaxBVHDepth + 1 };
+
+		//Compressed meshes are intersected in object space. The direction is not normalized, so t along it is the same as in world space.
+		inline const Ray& GetMeshSpaceRay(const TriangleMesh& mesh, const Ray& ray, Ray& objectSpaceRay)
 		{
-			const BVHNode& node{ mesh.bvhNodes[nodeIndex] };
+			if (!mesh.isCompressed) return ray;
 
-			if (!SlabTest_BoundingBox(node.minAABB, node.maxAABB, ray)) return;
+			objectSpaceRay = ray;
+			objectSpaceRay.origin = mesh.worldToObject.TransformPoint(ray.origin);
+			objectSpaceRay.direction = mesh.worldToObject.TransformVector(ray.direction);
+			objectSpaceRay.inverseDirection = { 1.f / objectSpaceRay.direction.x, 1.f / objectSpaceRay.direction.y, 1.f / objectSpaceRay.direction.z };
 
-			if (node.nrPrimitives != 0) //Leaf
-			{
-				indices.push_back(nodeIndex);
-				return;
-			}
-			else
+			return objectSpaceRay;
+		}
+
+		/**
+		 * \brief Depth-first traversal with the stack on the call stack, so no memory is allocated per ray
+		 * InitBVH never builds trees deeper than the stack, a tree from elsewhere (e.g. an old mesh cache) continues in a nested call when it is full.
+		 * \param ray In the space of the BVH, see GetMeshSpaceRay
+		 * \param leafTest Tests the triangles of a leaf whose box the ray hits, returns true to stop the traversal
+		 * \return Whether leafTest stopped the traversal
+		 */
+		template<typename LeafTest>
+		inline bool TraverseBVH(const TriangleMesh& mesh, const Ray& ray, uint32_t firstNodeIndex, const LeafTest& leafTest)
+		{
+			uint32_t stack[BVH_STACK_SIZE];
+			uint32_t stackSize{};
+			stack[stackSize++] = firstNodeIndex;
+
+			while (stackSize > 0)
 			{
-				IntersectBVH(ray, mesh, node.leftFirst, indices);
-				IntersectBVH(ray, mesh, node.leftFirst + 1, indices);
+				const BVHNode& node{ mesh.bvhNodes[stack[--stackSize]] };
+
+				RAY_STATISTIC(nodesVisited);
+				if (!SlabTest_BoundingBox(node.minAABB, node.maxAABB, ray)) continue;
+
+				if (node.nrPrimitives != 0) //Leaf
+				{
+					RAY_STATISTIC(leavesVisited);
+					if (leafTest(node)) return true;
+					continue;
+				}
+
+				if (stackSize + 2 > BVH_STACK_SIZE) [[unlikely]]
+				{
+					if (TraverseBVH(mesh, ray, node.leftFirst + 1, leafTest) || TraverseBVH(mesh, ray, node.leftFirst, leafTest)) return true;
+					continue;
+				}
+
+				stack[stackSize++] = node.leftFirst;
+				stack[stackSize++] = node.leftFirst + 1;
 			}
-		}
 
-		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
-		{			
-			std::vector<int> indices{};
-			IntersectBVH(ray, mesh, mesh.rootNodeIndex, indices);
+			return false;
+		}
 
-			if (indices.size() == 0) return hitRecord.didHit;
+		//Any-hit traversal for shadow rays, stops at the first triangle that blocks the ray
+		inline bool HitTest_TriangleMesh_AnyHit(const TriangleMesh& mesh, const Ray& worldRay)
+		{
+			Ray objectSpaceRay{};
+			const Ray& ray{ GetMeshSpaceRay(mesh, worldRay, objectSpaceRay) };
 
 			Triangle triangle{};
 			triangle.cullMode = mesh.cullMode;
-			triangle.materialIndex = mesh.materialIndex;
 
-			for (size_t index{}; index < indices.size(); index++)
-			{
-				uint32_t start{mesh.bvhNodes[indices[index]].leftFirst};
-				uint32_t end{ start + mesh.bvhNodes[indices[index]].nrPrimitives };
+			return TraverseBVH(mesh, ray, mesh.rootNodeIndex, [&](const BVHNode& leaf)
+				{
+					const uint32_t end{ leaf.leftFirst + leaf.nrPrimitives };
 
-				for (uint32_t currentTriangle{ start }; currentTriangle < end; ++currentTriangle)
+					for (uint32_t currentTriangle{ leaf.leftFirst }; currentTriangle < end; ++currentTriangle)
+					{
+						mesh.GetTriangle(currentTriangle, triangle.v0, triangle.v1, triangle.v2);
+
+						if (HitTest_Triangle(triangle, ray)) return true;
+					}
+					return false;
+				});
+		}
+
+		//Closest-hit traversal
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& worldRay, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			Ray objectSpaceRay{};
+			const Ray& ray{ GetMeshSpaceRay(mesh, worldRay, objectSpaceRay) };
+
+			Triangle triangle{};
+			triangle.cullMode = mesh.cullMode;
+
+			//Only stopped early when the hit record is ignored, then any hit will do
+			const bool isStopped{ TraverseBVH(mesh, ray, mesh.rootNodeIndex, [&](const BVHNode& leaf)
 				{
-					triangle.v0 = mesh.transformedPositions[mesh.indices[currentTriangle * 3]];
-					triangle.v1 = mesh.transformedPositions[mesh.indices[currentTriangle * 3 + 1]];
-					triangle.v2 = mesh.transformedPositions[mesh.indices[currentTriangle * 3 + 2]];
-					triangle.normal = mesh.transformedNormals[currentTriangle];
+					const uint32_t end{ leaf.leftFirst + leaf.nrPrimitives };
+
+					for (uint32_t currentTriangle{ leaf.leftFirst }; currentTriangle < end; ++currentTriangle)
+					{
+						mesh.GetTriangle(currentTriangle, triangle.v0, triangle.v1, triangle.v2);
+
+						const float previousT{ hitRecord.t };
+						if (!HitTest_Triangle(triangle, ray, hitRecord, ignoreHitRecord)) continue;
+						if (ignoreHitRecord) return true;
+
+						if (hitRecord.t < previousT)
+						{
+							hitRecord.primitiveIndex = currentTriangle;
+							hitRecord.pMesh = &mesh;
+						}
+					}
+					return false;
+				}) };
+
+			return isStopped || hitRecord.didHit;
+		}
 
-					if (HitTest_Triangle(triangle, ray, hitRecord, ignoreHitRecord) && ignoreHitRecord) return true;
-				}
-			}
+		//Position, normal and material of the closest hit, done once per ray instead of for every closer hit found during traversal
+		inline void ResolveHit(const Ray& ray, HitRecord& hitRecord)
+		{
+			if (!hitRecord.didHit) return;
+
+			hitRecord.origin = ray.origin + ray.direction * hitRecord.t;
 
-			return hitRecord.didHit;
+			switch (hitRecord.type)
+			{
+			case HitType::Sphere:
+				hitRecord.normal = (hitRecord.origin - hitRecord.pSphere->origin) / hitRecord.pSphere->radius;
+				hitRecord.materialIndex = hitRecord.pSphere->materialIndex;
+				break;
+			case HitType::Plane:
+				hitRecord.normal = hitRecord.pPlane->normal;
+				hitRecord.materialIndex = hitRecord.pPlane->materialIndex;
+				break;
+			case HitType::Triangle:
+			{
+				const TriangleMesh& mesh{ *hitRecord.pMesh };
+
+				hitRecord.normal = mesh.GetNormal(hitRecord.primitiveIndex, hitRecord.u, hitRecord.v);
+				hitRecord.materialIndex = mesh.materialIndex;
+				break;
+			}
+			default:
+				break;
+			}
 		}
 
 		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_TriangleMesh(mesh, ray, temp, true);
+			return HitTest_TriangleMesh_AnyHit(mesh, ray);
 		}
 #pragma endregion
 	}
 
 	namespace LightUtils
 	{
-		//Direction from target to light
+		//Direction from target to light, unnormalized for point lights (its length is the distance to the light)
 		inline Vector3 GetDirectionToLight(const Light& light, const Vector3 origin)
 		{
+			if (light.type == LightType::Directional) return -light.direction;
+
 			return { light.origin - origin };
 		}
 
+		//Directional lights have no inverse-square falloff
 		inline ColorRGB GetRadiance(const Light& light, const Vector3& target)
 		{
+			if (light.type == LightType::Directional) return light.color * light.intensity;
+
 			return { light.color * light.intensity / (GetDirectionToLight(light, target).SqrMagnitude()) };
 		}
 	}
 
 	namespace Utils
 	{
-		//Just parses vertices and indices
+		//Parses positions and triangle indices, normals are calculated per triangle
+		//The outputs are overwritten, not appended to. On failure they are left as they were.
 #pragma warning(push)
 #pragma warning(disable : 4505) //Warning unreferenced local function
 		static bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
 		{
-			std::ifstream file(filename);
-			if (!file)
+			ObjData data{};
+			if (!ObjLoader::Load(filename, data))
 				return false;
 
-			std::string sCommand;
-			// start a while iteration ending when the end of file is reached (ios::eof)
-			while (!file.eof())
-			{
-				//read the first word of the string, use the >> operator (istream::operator>>) 
-				file >> sCommand;
-				//use conditional statements to process the different commands	
-				if (sCommand == "#")
-				{
-					// Ignore Comment
-				}
-				else if (sCommand == "v")
-				{
-					//Vertex
-					float x, y, z;
-					file >> x >> y >> z;
-					positions.push_back({ x, y, z });
-				}
-				else if (sCommand == "f")
-				{
-					float i0, i1, i2;
-					file >> i0 >> i1 >> i2;
-
-					indices.push_back((int)i0 - 1);
-					indices.push_back((int)i1 - 1);
-					indices.push_back((int)i2 - 1);
-				}
-				//read till end of line and ignore all remaining chars
-				file.ignore(1000, '\n');
-
-				if (file.eof()) 
-					break;
-			}
+			positions = std::move(data.positions);
+			indices.assign(data.positionIndices.begin(), data.positionIndices.end());
 
 			//Precompute normals
+			normals.resize(data.GetNumberOfTriangles());
 			for (uint64_t index = 0; index < indices.size(); index += 3)
 			{
-				uint32_t i0 = indices[index];
-				uint32_t i1 = indices[index + 1];
-				uint32_t i2 = indices[index + 2];
-
-				Vector3 edgeV0V1 = positions[i1] - positions[i0];
-				Vector3 edgeV0V2 = positions[i2] - positions[i0];
-				Vector3 normal = Vector3::Cross(edgeV0V1, edgeV0V2);
-
-				if(isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normal.Normalize();
-				if (isnan(normal.x))
-				{
-					int k = 0;
-				}
+				const Vector3& v0 = positions[indices[index]];
+				const Vector3& v1 = positions[indices[index + 1]];
+				const Vector3& v2 = positions[indices[index + 2]];
 
-				normals.push_back(normal);
+				normals[index / 3] = Vector3::Cross(v1 - v0, v2 - v0).Normalized();
 			}
 
 			return true;
@@ -0,0 +1,106 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "Vector3.h"
+
+namespace dae
+{
+	//Position stored as 16 bit fractions of the bounding box of its mesh
+	struct QuantizedPosition
+	{
+		uint16_t x, y, z;
+	};
+
+	//Maps positions inside a box to QuantizedPosition and back
+	//Decoding is exact and deterministic, so vertices shared by triangles decode to the same position and meshes stay watertight.
+	struct PositionQuantizer
+	{
+		PositionQuantizer() = default;
+		PositionQuantizer(const Vector3& boundsMin, const Vector3& boundsMax) :
+			min{ boundsMin },
+			step{ GetStep(boundsMin.x, boundsMax.x), GetStep(boundsMin.y, boundsMax.y), GetStep(boundsMin.z, boundsMax.z) }
+		{
+		}
+
+		Vector3 min{};
+		Vector3 step{}; //Size of one quantization step on every axis
+
+		QuantizedPosition Encode(const Vector3& position) const
+		{
+			return { Quantize(position.x, min.x, step.x), Quantize(position.y, min.y, step.y), Quantize(position.z, min.z, step.z) };
+		}
+
+		Vector3 Decode(const QuantizedPosition& position) const
+		{
+			return { min.x + position.x * step.x, min.y + position.y * step.y, min.z + position.z * step.z };
+		}
+
+	private:
+		static constexpr float MaxValue{ 65535.f };
+
+		static float GetStep(float min, float max)
+		{
+			return max > min ? (max - min) / MaxValue : 0.f;
+		}
+
+		static uint16_t Quantize(float value, float min, float step)
+		{
+			if (step == 0.f) return 0;
+			return static_cast<uint16_t>(std::clamp(std::round((value - min) / step), 0.f, MaxValue));
+		}
+	};
+
+	namespace OctahedralNormal
+	{
+		namespace Detail
+		{
+			inline float SignNotZero(float value) { return value >= 0.f ? 1.f : -1.f; }
+
+			inline uint32_t PackSnorm16(float value)
+			{
+				return static_cast<uint16_t>(static_cast<int16_t>(std::round(std::clamp(value, -1.f, 1.f) * 32767.f)));
+			}
+
+			inline float UnpackSnorm16(uint32_t value)
+			{
+				return std::max(static_cast<float>(static_cast<int16_t>(static_cast<uint16_t>(value))) / 32767.f, -1.f);
+			}
+		}
+
+		//Unit vector projected on an octahedron that is unfolded to a square, 16 bits per coordinate
+		inline uint32_t Encode(const Vector3& normal)
+		{
+			const float inverseLength{ 1.f / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z)) };
+
+			float x{ normal.x * inverseLength };
+			float y{ normal.y * inverseLength };
+
+			//Lower half is folded over the diagonals
+			if (normal.z < 0.f)
+			{
+				const float foldedX{ (1.f - std::abs(y)) * Detail::SignNotZero(x) };
+				y = (1.f - std::abs(x)) * Detail::SignNotZero(y);
+				x = foldedX;
+			}
+
+			return Detail::PackSnorm16(x) | (Detail::PackSnorm16(y) << 16);
+		}
+
+		inline Vector3 Decode(uint32_t encoded)
+		{
+			Vector3 normal{ Detail::UnpackSnorm16(encoded), Detail::UnpackSnorm16(encoded >> 16), 0.f };
+			normal.z = 1.f - std::abs(normal.x) - std::abs(normal.y);
+
+			if (normal.z < 0.f)
+			{
+				const float unfoldedX{ (1.f - std::abs(normal.y)) * Detail::SignNotZero(normal.x) };
+				normal.y = (1.f - std::abs(normal.x)) * Detail::SignNotZero(normal.y);
+				normal.x = unfoldedX;
+			}
+
+			return normal.Normalized();
+		}
+	}
+}
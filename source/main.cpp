@@ -5,12 +5,14 @@
 #undef main
 
 //Standard includes
+#include <cstring>
 #include <iostream>
 
 //Project includes
 #include "Timer.h"
 #include "Renderer.h"
 #include "Scene.h"
+#include "RenderThread.h"
 
 using namespace dae;
 
@@ -20,6 +22,16 @@ void ShutDown(SDL_Window* pWindow)
 	SDL_Quit();
 }
 
+//Copies a frame of the render thread to the window, SDL converts it when the window uses another pixel format
+void Present(SDL_Window* pWindow, uint32_t* pPixels, int width, int height)
+{
+	SDL_Surface* pFrame = SDL_CreateRGBSurfaceWithFormatFrom(pPixels, width, height, 32, width * sizeof(uint32_t), SDL_PIXELFORMAT_ARGB8888);
+	SDL_BlitSurface(pFrame, nullptr, SDL_GetWindowSurface(pWindow), nullptr);
+	SDL_FreeSurface(pFrame);
+
+	SDL_UpdateWindowSurface(pWindow);
+}
+
 int main(int argc, char* args[])
 {
 	//Unreferenced parameters
@@ -43,7 +55,6 @@ int main(int argc, char* args[])
 
 	//Initialize "framework"
 	const auto pTimer = new Timer();
-	const auto pRenderer = new Renderer(pWindow);
 
 	//const auto pScene = new Scene_W4_ReferenceScene();
 	//const auto pScene = new Scene_W4_BunnyScene();
@@ -51,65 +62,93 @@ int main(int argc, char* args[])
 
 	pScene->Initialize();
 
+	//This thread handles input and moves its own camera, the render thread renders with the newest one it was given
+	Camera camera = pScene->GetCamera();
+	const auto pRenderThread = new RenderThread(pScene, width, height);
+	pRenderThread->SetCamera(camera);
+
+	//F8: renders at most this long per frame, a frame that takes longer is presented in parts
+	const float frameBudgetSeconds = 1.f / 30.f;
+
+	//The loop waits for input or a finished frame, at most this long
+	const int inputWaitMilliseconds = 100;
+
 	//Start loop
+	pRenderThread->Start();
 	pTimer->Start();
-	float printTimer = 0.f;
 	bool isLooping = true;
-	bool takeScreenshot = false;
+	bool hasFrame = false;
 	while (isLooping)
 	{
+		bool isPresentNeeded = false;
+
 		//--------- Get input events ---------
 		SDL_Event e;
-		while (SDL_PollEvent(&e))
+		bool hasEvent = SDL_WaitEventTimeout(&e, inputWaitMilliseconds);
+		for (; hasEvent; hasEvent = SDL_PollEvent(&e))
 		{
 			switch (e.type)
 			{
 			case SDL_QUIT:
 				isLooping = false;
 				break;
+			case SDL_WINDOWEVENT:
+				if (e.window.event == SDL_WINDOWEVENT_EXPOSED)
+					isPresentNeeded = true;
+				break;
 			case SDL_KEYUP:
 				if(e.key.keysym.scancode == SDL_SCANCODE_X)
-					takeScreenshot = true;
+					pRenderThread->RequestScreenshot();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F2)
-					pRenderer->ToggleShadows();
+					pRenderThread->Post([](Renderer& renderer) { renderer.ToggleShadows(); });
 				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
-					pRenderer->CycleLightingMode();
+					pRenderThread->Post([](Renderer& renderer) { renderer.CycleLightingMode(); });
+				if (e.key.keysym.scancode == SDL_SCANCODE_F4)
+					pRenderThread->Post([](Renderer& renderer) { renderer.ToggleShadowCache(); });
+				if (e.key.keysym.scancode == SDL_SCANCODE_F5)
+					pRenderThread->Post([](Renderer& renderer) { renderer.ToggleHeatmap(); });
 				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
-					pTimer->StartBenchmark();
+					pRenderThread->StartProfileCapture();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F7)
+					pRenderThread->ToggleDynamicResolution();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+				{
+					pRenderThread->Post([frameBudgetSeconds](Renderer& renderer)
+						{
+							renderer.SetFrameBudget(renderer.GetFrameBudget() > 0.f ? 0.f : frameBudgetSeconds);
+							std::cout << "Frame budget " << (renderer.GetFrameBudget() > 0.f ? "on" : "off") << std::endl;
+						});
+				}
 				break;
 			}
 		}
 
-		//--------- Update ---------
-		pScene->Update(pTimer);
-
-		//--------- Render ---------
-		pRenderer->Render(pScene);
+		//--------- Camera ---------
+		//Only changes wake the render thread
+		const Matrix lastCameraToWorld = camera.cameraToWorld;
+		const float lastFovAngle = camera.fovAngle;
 
-		//--------- Timer ---------
 		pTimer->Update();
-		printTimer += pTimer->GetElapsed();
-		if (printTimer >= 1.f)
-		{
-			printTimer = 0.f;
-			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
-		}
+		camera.Update(pTimer);
+		if (camera.fovAngle != lastFovAngle || memcmp(&camera.cameraToWorld, &lastCameraToWorld, sizeof(Matrix)) != 0)
+			pRenderThread->SetCamera(camera);
 
-		//Save screenshot after full render
-		if (takeScreenshot)
+		//--------- Present ---------
+		if (pRenderThread->AcquireFrame())
 		{
-			if (!pRenderer->SaveBufferToImage())
-				std::cout << "Screenshot saved!" << std::endl;
-			else
-				std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
-			takeScreenshot = false;
+			hasFrame = true;
+			isPresentNeeded = true;
 		}
+
+		if (isPresentNeeded && hasFrame)
+			Present(pWindow, pRenderThread->GetFramePixels(), width, height);
 	}
+	pRenderThread->Stop();
 	pTimer->Stop();
 
 	//Shutdown "framework"
+	delete pRenderThread;
 	delete pScene;
-	delete pRenderer;
 	delete pTimer;
 
 	ShutDown(pWindow);